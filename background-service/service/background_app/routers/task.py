@@ -1,5 +1,6 @@
 """Module with spectrogram API routes."""
 
+import struct
 from pathlib import Path
 
 from fastapi import APIRouter, Depends, HTTPException, Response, status
@@ -15,8 +16,11 @@ from background_app.routers.dependencies import (
     get_redis_storage,
     parse_body
 )
-from gstream.files.scripts import DelaysRunnerScriptFile
-from gstream.models import TaskState, TaskStatus, TaskType
+from gstream.files.scripts import (
+    DelaysRunnerScriptFile,
+    DelaysStreamRunnerScriptFile
+)
+from gstream.models import Array, TaskState, TaskStatus, TaskType
 from gstream.node.common import convert_megabytes_to_bytes
 from gstream.storage.file_system import Storage as FileStorage
 from gstream.storage.redis import Storage as RedisStorage
@@ -135,10 +139,78 @@ async def load_input_args(
             path=Path(file_storage.root, state.script_filename),
             task_id=task_id
         ).save()
+    if state.type_ == TaskType.DELAYS_STREAM.value:
+        await DelaysStreamRunnerScriptFile(
+            path=Path(file_storage.root, state.script_filename),
+            task_id=task_id
+        ).save()
 
     return Response(status_code=status.HTTP_200_OK)
 
 
+@router.post('/append')
+@check_task_exist
+async def append_stream_block(
+        task_id: str,
+        params: bytes = Depends(parse_body),
+        redis_storage: RedisStorage = Depends(get_redis_storage),
+        file_storage: FileStorage = Depends(get_file_storage)
+) -> Response:
+    """Append signals block (stations x samples) to streaming task.
+
+    Block with zero samples closes the stream.
+
+    Args:
+        task_id: str
+        params: bytes
+        redis_storage: RedisStorage
+        file_storage: FileStorage
+
+    Returns: Response
+
+    """
+    if len(params) > convert_megabytes_to_bytes(
+            value=MAXIMAL_INPUT_MEGABYTES_SIZE
+    ):
+        raise HTTPException(
+            status_code=status.HTTP_413_REQUEST_ENTITY_TOO_LARGE,
+            detail='Too large parameter bytes size'
+        )
+
+    state = await redis_storage.get_task_state(task_id=task_id)
+    if state.type_ != TaskType.DELAYS_STREAM.value:
+        raise HTTPException(
+            status_code=status.HTTP_400_BAD_REQUEST,
+            detail=f'Task has type {state.type_} (not streaming!)'
+        )
+    if state.status in (
+            TaskStatus.FAILED.value,
+            TaskStatus.FINISHED.value,
+            TaskStatus.KILLED.value
+    ):
+        raise HTTPException(
+            status_code=status.HTTP_400_BAD_REQUEST,
+            detail=f'Task has status {state.status}'
+        )
+
+    # worker waits for the rest of incomplete block, so reject it here
+    try:
+        block = Array.create_from_bytes(bytes_obj=params)
+    except (TypeError, ValueError, struct.error):
+        block = None
+    if block is None or block.bytes_size != len(params):
+        raise HTTPException(
+            status_code=status.HTTP_400_BAD_REQUEST,
+            detail='Invalid signals block'
+        )
+
+    await file_storage.append_binary_data(
+        data=params,
+        filename=state.stream_filename
+    )
+    return Response(status_code=status.HTTP_200_OK)
+
+
 @router.post('/run')
 @check_task_is_ready_for_run
 @check_task_exist
@@ -259,3 +331,43 @@ async def get_result(
         content=data,
         headers={'Content-Type': 'application/octet-stream'}
     )
+
+
+@router.get('/detections')
+@check_task_exist
+async def get_detections(
+        task_id: str,
+        offset: int = 0,
+        redis_storage: RedisStorage = Depends(get_redis_storage),
+        file_storage: FileStorage = Depends(get_file_storage)
+) -> Response:
+    """Returns streaming task detections (bytes format) from offset.
+
+    Args:
+        task_id: str
+        offset: count of already received bytes
+        redis_storage: RedisStorage
+        file_storage: FileStorage
+
+    Returns: Response
+
+    """
+    if offset < 0:
+        raise HTTPException(
+            status_code=status.HTTP_400_BAD_REQUEST,
+            detail='Offset can`t be negative'
+        )
+
+    state = await redis_storage.get_task_state(task_id=task_id)
+    detections_filename = state.detections_filename
+
+    data = b''
+    if file_storage.is_file_exist(filename=detections_filename):
+        data = await file_storage.get_binary_data_from_file(
+            filename=detections_filename,
+            offset=offset
+        )
+    return Response(
+        content=data,
+        headers={'Content-Type': 'application/octet-stream'}
+    )
@@ -624,3 +624,176 @@ class TestTask:
             actual_or_assertion=response.headers['content-type'],
             matcher=equal_to('application/octet-stream')
         )
+
+    @pytest.mark.negative
+    @patch('gstream.models.check_task_type')
+    @pytest.mark.asyncio
+    async def test_append_stream_block_wrong_type(
+            self,
+            mock_check_task_type: Mock,
+            get_async_client: Callable
+    ):
+        mock_check_task_type.return_value = 'test-type'
+
+        url = URL_PATTERN.format(
+            host=APP_HOST,
+            port=APP_PORT,
+            root_path=ROOT_PATH,
+            endpoint='append'
+        )
+        params = {
+            'task_id': 'task_id',
+        }
+        expected_value = TaskState(
+            user_id='test-id',
+            type_='test-type'
+        )
+        dependency_mock = DependencyMock(task_state=expected_value)
+
+        app = FastAPI(root_path=ROOT_PATH)
+        with patch(
+                'background_app.routers.checkers.check_task_exist',
+                mock_decorator
+        ):
+            reload(task)
+            app.include_router(task.router)
+
+            new_dependencies = {
+                get_redis_storage: dependency_mock.override_get_redis_storage,
+                parse_body: DependencyMock.override_parse_body,
+                get_file_storage: DependencyMock.override_get_file_storage
+            }
+            app.dependency_overrides.update(new_dependencies)
+
+            response = await get_async_client(app=app).post(
+                url=url,
+                params=params
+            )
+        assert_that(
+            actual_or_assertion=response.status_code,
+            matcher=equal_to(status.HTTP_400_BAD_REQUEST)
+        )
+        assert_that(
+            actual_or_assertion=response.json()['detail'],
+            matcher=equal_to(
+                f'Task has type {expected_value.type_} (not streaming!)'
+            )
+        )
+
+    @pytest.mark.positive
+    @patch.object(FileStorage, 'get_binary_data_from_file')
+    @patch.object(FileStorage, 'is_file_exist')
+    @patch.object(RedisStorage, 'get_task_state')
+    @patch('gstream.models.check_task_type')
+    @pytest.mark.asyncio
+    async def test_get_detections_positive(self,
+                                           mock_check_task_type: Mock,
+                                           mock_get_task_state: Mock,
+                                           mock_is_file_exist: Mock,
+                                           mock_get_binary_data: Mock,
+                                           get_async_client: Callable):
+        mock_check_task_type.return_value = 'test-type'
+
+        url = URL_PATTERN.format(
+            host=APP_HOST,
+            port=APP_PORT,
+            root_path=ROOT_PATH,
+            endpoint='detections'
+        )
+        task_id, offset = 'task_id', 16
+        params = {
+            'task_id': task_id,
+            'offset': offset
+        }
+        detections_filename = 'test-detections'
+        task_state = AsyncMock(detections_filename=detections_filename)
+        mock_get_task_state.return_value = task_state
+        mock_is_file_exist.return_value = True
+        expected_value = b'test-data'
+        mock_get_binary_data.return_value = expected_value
+
+        app = FastAPI(root_path=ROOT_PATH)
+
+        with patch(
+            'background_app.routers.checkers.check_task_exist',
+            mock_decorator
+        ):
+            reload(task)
+            app.include_router(task.router)
+
+            new_dependencies = {
+                get_redis_storage:
+                    DependencyMock.override_get_redis_with_instance,
+                get_file_storage:
+                    DependencyMock.override_get_file_storage_with_instance
+            }
+            app.dependency_overrides.update(new_dependencies)
+
+            response = await get_async_client(app=app).get(
+                url=url,
+                params=params
+            )
+        mock_get_task_state.assert_called_once_with(task_id=task_id)
+        mock_get_binary_data.assert_called_once_with(
+            filename=detections_filename,
+            offset=offset
+        )
+        assert_that(
+            actual_or_assertion=response.status_code,
+            matcher=equal_to(status.HTTP_200_OK)
+        )
+        assert_that(
+            actual_or_assertion=response.content,
+            matcher=equal_to(expected_value)
+        )
+
+    @pytest.mark.negative
+    @patch.object(FileStorage, 'get_binary_data_from_file')
+    @patch.object(RedisStorage, 'get_task_state')
+    @patch('gstream.models.check_task_type')
+    @pytest.mark.asyncio
+    async def test_get_detections_negative(self,
+                                           mock_check_task_type: Mock,
+                                           mock_get_task_state: Mock,
+                                           mock_get_binary_data: Mock,
+                                           get_async_client: Callable):
+        mock_check_task_type.return_value = 'test-type'
+
+        url = URL_PATTERN.format(
+            host=APP_HOST,
+            port=APP_PORT,
+            root_path=ROOT_PATH,
+            endpoint='detections'
+        )
+        params = {
+            'task_id': 'task_id',
+            'offset': -1
+        }
+
+        app = FastAPI(root_path=ROOT_PATH)
+
+        with patch(
+            'background_app.routers.checkers.check_task_exist',
+            mock_decorator
+        ):
+            reload(task)
+            app.include_router(task.router)
+
+            new_dependencies = {
+                get_redis_storage:
+                    DependencyMock.override_get_redis_with_instance,
+                get_file_storage:
+                    DependencyMock.override_get_file_storage_with_instance
+            }
+            app.dependency_overrides.update(new_dependencies)
+
+            response = await get_async_client(app=app).get(
+                url=url,
+                params=params
+            )
+        mock_get_task_state.assert_not_called()
+        mock_get_binary_data.assert_not_called()
+        assert_that(
+            actual_or_assertion=response.status_code,
+            matcher=equal_to(status.HTTP_400_BAD_REQUEST)
+        )
@@ -6,7 +6,8 @@ from typing import Dict
 from gstream.files.base import BaseTxtFileWriter
 
 __all__ = [
-    'DelaysRunnerScriptFile'
+    'DelaysRunnerScriptFile',
+    'DelaysStreamRunnerScriptFile'
 ]
 
 DELAYS_SCRIPT_BODY = """
@@ -52,6 +53,11 @@ if __name__ == '__main__':
 
 """
 
+DELAYS_STREAM_SCRIPT_BODY = DELAYS_SCRIPT_BODY.replace(
+    'from gstream.worker.delays_finder import DelaysFinder',
+    'from gstream.worker.delays_stream import DelaysStreamFinder'
+).replace('proc = DelaysFinder(', 'proc = DelaysStreamFinder(')
+
 
 class BaseRunnerScriptFile(BaseTxtFileWriter):
     """Base class."""
@@ -90,3 +96,20 @@ class DelaysRunnerScriptFile(BaseRunnerScriptFile):
             template_body=DELAYS_SCRIPT_BODY,
             replace_arguments={'[task-id]': task_id}
         )
+
+
+class DelaysStreamRunnerScriptFile(BaseRunnerScriptFile):
+    """Class for generate streaming delays running script."""
+
+    def __init__(self, path: Path, task_id: str):
+        """Initialize class method.
+
+        Args:
+            path: saving path
+            task_id: task_id [str]
+        """
+        super().__init__(
+            path=path,
+            template_body=DELAYS_STREAM_SCRIPT_BODY,
+            replace_arguments={'[task-id]': task_id}
+        )
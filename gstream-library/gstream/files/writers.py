@@ -1,13 +1,15 @@
 """Module for working output binary files."""
 
 from pathlib import Path
+from typing import List
 
 from gstream.files.base import BaseBinaryFileWriter
 from gstream.models import Array, DelaysFinderParameters
 
 __all__ = [
     'DelaysFinderArgsBinaryFile',
-    'DelaysFinderResultBinaryFile'
+    'DelaysFinderResultBinaryFile',
+    'DiffFunctionResultBinaryFile'
 ]
 
 
@@ -69,3 +71,33 @@ class DelaysFinderResultBinaryFile(BaseBinaryFileWriter):
 
         """
         return self._data.convert_to_bytes()
+
+
+class DiffFunctionResultBinaryFile(BaseBinaryFileWriter):
+    """Class for operations with binary output file."""
+
+    def __init__(self, path: Path, data: List[Array]):
+        """Initialize class method.
+
+        Args:
+            path: path to file
+            data: writing python object (arrays written one by one)
+        """
+        super().__init__(path=path, data=data)
+
+    @property
+    def _data(self) -> List[Array]:
+        """Returns source data (python list of Array).
+
+        Returns: List[Array]
+
+        """
+        return self._BaseBinaryFileWriter__data
+
+    def _convert_to_bytes(self) -> bytes:
+        """Convert python object (list of Array) to bytes.
+
+        Returns: bytes
+
+        """
+        return b''.join(array.convert_to_bytes() for array in self._data)
@@ -1,5 +1,23 @@
 #define NULL_VALUE -9999
 #define MIN_STATIONS_COUNT 3
+// task values given by build options are compile-time constants, so the
+// stations and window loops get fixed bounds (they are not unrolled, the
+// stations loop body holds the scanner and window loops)
+#ifdef STATIONS_COUNT
+#define get_stations_count(stations_count) STATIONS_COUNT
+#else
+#define get_stations_count(stations_count) (stations_count)
+#endif
+#ifdef SCANNER_SIZE
+#define get_scanner_size(scanner_size) SCANNER_SIZE
+#else
+#define get_scanner_size(scanner_size) (scanner_size)
+#endif
+#ifdef WINDOW_SIZE
+#define get_window_size(window_size) WINDOW_SIZE
+#else
+#define get_window_size(window_size) (window_size)
+#endif
 
 
 int get_global_thread_id()
@@ -9,22 +27,205 @@ int get_global_thread_id()
     return block_id * get_local_size(0) * get_local_size(1) * get_local_size(2) + thread_local_id;
 }
 
-bool is_good_signal_part(global const float *signals,
+bool is_good_signal_part(global const int *repeats_prefix,
 						int start_index, int window_size){
-	// TODO: нет контроля выхода за пределы массива
-	int counter = 0;
-	float last_value = signals[start_index];
-	for (int i = start_index + 1; i < start_index + window_size; i++){
-		if (signals[i] == last_value){
-			counter ++;
+	// repeats_prefix holds per station inclusive counts of samples equal
+	// to the previous one, see fill_repeats_prefix
+	return repeats_prefix[start_index + window_size - 1] == repeats_prefix[start_index];
+}
+
+
+kernel void count_segment_repeats(global const float *signals, int signal_length,
+								  int stations_count, int segment_length,
+								  int first_segment_index, int segments_count,
+								  global int *segments_repeats){
+	// only segments_count segments from first_segment_index are counted,
+	// prefix of the other signal indexes is left as it is
+	int global_id = get_global_thread_id();
+
+	if (global_id > stations_count * segments_count - 1){
+		return;
+	}
+
+	int station_signal_index = (global_id / segments_count) * signal_length;
+	int first_index = (first_segment_index + global_id % segments_count) * segment_length;
+	int last_index = min(first_index + segment_length, signal_length);
+
+	int repeats_count = 0;
+	for (int i = max(first_index, 1); i < last_index; i++){
+		repeats_count += signals[station_signal_index + i] == signals[station_signal_index + i - 1];
+	}
+	segments_repeats[global_id] = repeats_count;
+}
+
+
+kernel void scan_segment_repeats(int stations_count, int segments_count,
+								 global int *segments_repeats){
+	int station_index = get_global_thread_id();
+
+	if (station_index > stations_count - 1){
+		return;
+	}
+
+	int repeats_count = 0;
+	for (int i = station_index * segments_count; i < (station_index + 1) * segments_count; i++){
+		int segment_repeats_count = segments_repeats[i];
+		segments_repeats[i] = repeats_count;
+		repeats_count += segment_repeats_count;
+	}
+}
+
+
+kernel void fill_repeats_prefix(global const float *signals, int signal_length,
+								int stations_count, int segment_length,
+								int first_segment_index, int segments_count,
+								global const int *segments_repeats,
+								global int *repeats_prefix){
+	int global_id = get_global_thread_id();
+
+	if (global_id > stations_count * segments_count - 1){
+		return;
+	}
+
+	int station_signal_index = (global_id / segments_count) * signal_length;
+	int first_index = (first_segment_index + global_id % segments_count) * segment_length;
+	int last_index = min(first_index + segment_length, signal_length);
+
+	int repeats_count = segments_repeats[global_id];
+	for (int i = first_index; i < last_index; i++){
+		if (i > 0){
+			repeats_count += signals[station_signal_index + i] == signals[station_signal_index + i - 1];
+		}
+		repeats_prefix[station_signal_index + i] = repeats_count;
+	}
+}
+
+
+float get_correlation(float sum_a, float sum_qa, float sum_b, float sum_qb,
+					  float sum_ab, int window_size){
+	float numerator = sum_ab * window_size - sum_a * sum_b;
+	if (numerator < 0){
+		return NULL_VALUE;
+	}
+
+	float denominator =  sqrt((sum_qa * window_size - pown(sum_a, 2)) * (sum_qb * window_size - pown(sum_b, 2)));
+	if (denominator == 0){
+		return NULL_VALUE;
+	}
+	return numerator / denominator;
+}
+
+
+bool get_base_window_sums(global const float *signals,
+						  global const int *repeats_prefix,
+						  int base_signal_index, int window_size,
+						  float *sum_a, float *sum_qa){
+	if (!is_good_signal_part(repeats_prefix, base_signal_index, window_size)){
+		return false;
+	}
+
+	float min_value = 0;
+	float max_value = 0;
+
+	*sum_a = 0;
+	*sum_qa = 0;
+	for (int i = 0; i < get_window_size(window_size); i++){
+		int index = base_signal_index + i;
+		float val = signals[index];
+		min_value = min(min_value, val);
+		max_value = max(max_value, val);
+		*sum_a += val;
+		*sum_qa += pown(val, 2);
+	}
+	return min_value != max_value;
+}
+
+
+int get_optimal_delay(global const float *signals,
+					  global const int *repeats_prefix, int base_signal_index,
+					  int station_signal_index, int scanner_size,
+					  int window_size, float min_correlation,
+					  float sum_a, float sum_qa){
+	float max_value_correlation = -1;
+	int optimal_delay = NULL_VALUE;
+	for (int delay_index = 0; delay_index < get_scanner_size(scanner_size); delay_index++){
+		float sum_b = 0;
+		float sum_qb = 0;
+		float sum_ab = 0;
+
+		int current_signal_index = station_signal_index + delay_index;
+		if (!is_good_signal_part(repeats_prefix, current_signal_index, window_size)){
+			continue;
+		}
+		for (int j = 0; j < get_window_size(window_size); j++){
+			// TODO: нет контроля выхода за пределы массива
+			int moment_index_i = base_signal_index + j;
+			int moment_index_j = current_signal_index + j;
+			float val_a = signals[moment_index_i];
+			float val_b = signals[moment_index_j];
+			sum_b += val_b;
+			sum_qb += pown(val_b, 2);
+			sum_ab += val_a * val_b;
+		}
+
+		float corr = get_correlation(sum_a, sum_qa, sum_b, sum_qb, sum_ab, window_size);
+		if (corr == NULL_VALUE){
+			continue;
+		}
+
+		if ((min_correlation <= corr) && (max_value_correlation < corr)){
+			max_value_correlation = corr;
+			optimal_delay = delay_index;
 		}
-		last_value = signals[i];
 	}
-	return counter == 0;
+	return optimal_delay;
 }
 
 
-kernel void get_real_delays(global const float *signals, int signal_length,
+void find_row_delays(global const float *signals,
+					 global const int *repeats_prefix, int signal_length,
+					 int stations_count, int scanner_size, int window_size,
+					 float min_correlation, int base_station_index,
+					 int signal_time_index, global int *row_delays){
+	int base_signal_index = base_station_index * signal_length + signal_time_index;
+
+	float sum_a = 0;
+	float sum_qa = 0;
+	if (!get_base_window_sums(signals, repeats_prefix, base_signal_index, window_size, &sum_a, &sum_qa)){
+		row_delays[0] = 0;
+		return;
+	}
+
+	int selection_stations_count = 0;
+	for (int station_index = 0; station_index < get_stations_count(stations_count); station_index++){
+		if (station_index == base_station_index){
+			row_delays[station_index + 1] = 0;
+			continue;
+		}
+
+		int optimal_delay = get_optimal_delay(
+			signals, repeats_prefix, base_signal_index,
+			station_index * signal_length + signal_time_index, scanner_size,
+			window_size, min_correlation, sum_a, sum_qa
+		);
+
+		row_delays[station_index + 1] = optimal_delay;
+		if (optimal_delay != NULL_VALUE){
+			selection_stations_count++;
+		}
+	}
+
+	if (selection_stations_count > MIN_STATIONS_COUNT){
+		row_delays[0] = 1;
+	}
+	else{
+		row_delays[0] = 0;
+	}
+}
+
+
+kernel void get_real_delays(global const float *signals,
+							global const int *repeats_prefix, int signal_length,
 							int stations_count, int scanner_size,
 							int window_size, float min_correlation,
 							int base_station_index,
@@ -35,68 +236,316 @@ kernel void get_real_delays(global const float *signals, int signal_length,
 		return;
 	}
 
-	int base_signal_index = base_station_index * signal_length + time_index;
+	find_row_delays(
+		signals, repeats_prefix, signal_length, stations_count, scanner_size,
+		window_size, min_correlation, base_station_index, time_index,
+		real_delays + time_index * (get_stations_count(stations_count) + 1)
+	);
+}
+
+
+kernel void get_lag_correlations(global const float *signals, int signal_length,
+								 int stations_count, int scanner_size,
+								 int window_size, int base_station_index,
+								 int start_time_index, int block_length,
+								 int processing_length, int segment_length,
+								 global float *correlations){
+	// One work-item owns a (segment, station, delay) triple and walks time
+	// sequentially, so every windowed sum is updated in O(1) per step.
+	// Sums are seeded from scratch at the start of each segment, which
+	// bounds the float error accumulated by the sliding updates.
+	int global_id = get_global_thread_id();
+	int lags_count = stations_count * scanner_size;
+
+	int segment_index = global_id / lags_count;
+	int station_index = (global_id % lags_count) / scanner_size;
+	int delay_index = global_id % scanner_size;
 
-	if (!is_good_signal_part(signals, base_signal_index, window_size)){
+	if (station_index == base_station_index){
 		return;
 	}
 
+	int block_end_index = min(start_time_index + block_length, processing_length);
+	int first_time_index = start_time_index + segment_index * segment_length;
+	int last_time_index = min(first_time_index + segment_length, block_end_index);
+	if (first_time_index >= last_time_index){
+		return;
+	}
+
+	int base_signal_index = base_station_index * signal_length + first_time_index;
+	int current_signal_index = station_index * signal_length + first_time_index + delay_index;
+
 	float sum_a = 0;
 	float sum_qa = 0;
-	float min_value = 0;
-	float max_value = 0;
+	float sum_b = 0;
+	float sum_qb = 0;
+	float sum_ab = 0;
+	int base_repeats_count = 0;
+	int current_repeats_count = 0;
+	for (int j = 0; j < window_size; j++){
+		float val_a = signals[base_signal_index + j];
+		float val_b = signals[current_signal_index + j];
+		sum_a += val_a;
+		sum_qa += pown(val_a, 2);
+		sum_b += val_b;
+		sum_qb += pown(val_b, 2);
+		sum_ab += val_a * val_b;
+		if (j > 0){
+			base_repeats_count += val_a == signals[base_signal_index + j - 1];
+			current_repeats_count += val_b == signals[current_signal_index + j - 1];
+		}
+	}
 
-	for (int i = 0; i < window_size; i++){
-		int index = base_signal_index + i;
-		float val = signals[index];
-		min_value = min(min_value, val);
-		max_value = max(max_value, val);
-		sum_a += val;
-		sum_qa += pown(val, 2);
+	for (int time_index = first_time_index; time_index < last_time_index; time_index++){
+		float corr = NULL_VALUE;
+		if ((base_repeats_count == 0) && (current_repeats_count == 0)){
+			corr = get_correlation(sum_a, sum_qa, sum_b, sum_qb, sum_ab, window_size);
+		}
+		correlations[((time_index - start_time_index) * stations_count + station_index) * scanner_size + delay_index] = corr;
+
+		if (time_index + 1 == last_time_index){
+			break;
+		}
+
+		float out_a = signals[base_signal_index];
+		float out_b = signals[current_signal_index];
+		float in_a = signals[base_signal_index + window_size];
+		float in_b = signals[current_signal_index + window_size];
+
+		sum_a += in_a - out_a;
+		sum_qa += pown(in_a, 2) - pown(out_a, 2);
+		sum_b += in_b - out_b;
+		sum_qb += pown(in_b, 2) - pown(out_b, 2);
+		sum_ab += in_a * in_b - out_a * out_b;
+
+		base_repeats_count -= signals[base_signal_index + 1] == out_a;
+		base_repeats_count += in_a == signals[base_signal_index + window_size - 1];
+		current_repeats_count -= signals[current_signal_index + 1] == out_b;
+		current_repeats_count += in_b == signals[current_signal_index + window_size - 1];
+
+		base_signal_index++;
+		current_signal_index++;
 	}
+}
+
+
+kernel void select_real_delays(global const float *correlations,
+							   int stations_count, int scanner_size,
+							   float min_correlation, int base_station_index,
+							   int start_time_index, int block_length,
+							   int processing_length, global int *real_delays){
+	int time_index = start_time_index + get_global_thread_id();
 
-	if (min_value == max_value){
+	if ((time_index >= start_time_index + block_length) || (time_index >= processing_length)){
 		return;
 	}
 
 	int selection_stations_count = 0;
 	for (int station_index = 0; station_index < stations_count; station_index++){
 		if (station_index == base_station_index){
+			real_delays[time_index * (stations_count + 1) + station_index + 1] = 0;
 			continue;
 		}
 
+		int correlations_index = ((time_index - start_time_index) * stations_count + station_index) * scanner_size;
+
 		float max_value_correlation = -1;
 		int optimal_delay = NULL_VALUE;
 		for (int delay_index = 0; delay_index < scanner_size; delay_index++){
-			float sum_b = 0;
-			float sum_qb = 0;
-			float sum_ab = 0;
-
-			int current_signal_index = station_index * signal_length + time_index + delay_index;
-			if (!is_good_signal_part(signals, current_signal_index, window_size)){
+			float corr = correlations[correlations_index + delay_index];
+			if (corr == NULL_VALUE){
 				continue;
 			}
-			for (int j = 0; j < window_size; j++){
-				// TODO: нет контроля выхода за пределы массива
-				int moment_index_i = base_signal_index + j;
-				int moment_index_j = current_signal_index + j;
-				float val_a = signals[moment_index_i];
-				float val_b = signals[moment_index_j];
-				sum_b += val_b;
-				sum_qb += pown(val_b, 2);
-				sum_ab += val_a * val_b;
+
+			if ((min_correlation <= corr) && (max_value_correlation < corr)){
+				max_value_correlation = corr;
+				optimal_delay = delay_index;
+			}
+		}
+
+		real_delays[time_index * (stations_count + 1) + station_index + 1] = optimal_delay;
+		if (optimal_delay != NULL_VALUE){
+			selection_stations_count++;
+		}
+	}
+
+	if (selection_stations_count > MIN_STATIONS_COUNT){
+		real_delays[time_index * (stations_count + 1)] = 1;
+	}
+	else{
+		real_delays[time_index * (stations_count + 1)] = 0;
+	}
+}
+
+
+kernel void fill_fft_windows(global const float *signals, int signal_length,
+							 int stations_count, int scanner_size,
+							 int window_size, int base_station_index,
+							 int start_time_index, int block_length,
+							 int processing_length, int fft_size,
+							 global float2 *spectra){
+	// Base window is zero-padded after window_size samples, station
+	// segments after window_size + scanner_size - 1 samples, so the
+	// circular correlation has no wrap-around for delays < scanner_size.
+	int global_id = get_global_thread_id();
+	if (global_id > block_length * stations_count * fft_size - 1){
+		return;
+	}
+
+	int block_time_index = global_id / (stations_count * fft_size);
+	int station_index = (global_id / fft_size) % stations_count;
+	int sample_index = global_id % fft_size;
+	int time_index = start_time_index + block_time_index;
+
+	int samples_count = window_size + scanner_size - 1;
+	if (station_index == base_station_index){
+		samples_count = window_size;
+	}
+
+	float2 value = {0, 0};
+	if ((time_index < processing_length) && (sample_index < samples_count)){
+		value.x = signals[station_index * signal_length + time_index + sample_index];
+	}
+	spectra[global_id] = value;
+}
+
+
+kernel void fft_radix2_pass(global const float2 *input, global float2 *output,
+							int fft_size, int transforms_count,
+							int pass_size, int direction){
+	// One radix-2 Stockham pass (pass_size = 1, 2, 4 ... fft_size / 2)
+	// over a batch of transforms; direction is -1 for forward transform
+	// and 1 for inverse one (without 1 / fft_size normalization).
+	int global_id = get_global_thread_id();
+	int half_size = fft_size / 2;
+	if (global_id > transforms_count * half_size - 1){
+		return;
+	}
+
+	int transform_offset = (global_id / half_size) * fft_size;
+	int i = global_id % half_size;
+	int k = i & (pass_size - 1);
+
+	float2 u0 = input[transform_offset + i];
+	float2 u1 = input[transform_offset + i + half_size];
+
+	float alpha = direction * M_PI_F * k / pass_size;
+	float twiddle_cos = cos(alpha);
+	float twiddle_sin = sin(alpha);
+
+	float2 v1 = {
+		u1.x * twiddle_cos - u1.y * twiddle_sin,
+		u1.x * twiddle_sin + u1.y * twiddle_cos
+	};
+
+	int output_index = transform_offset + (i << 1) - k;
+	float2 sum = {u0.x + v1.x, u0.y + v1.y};
+	float2 diff = {u0.x - v1.x, u0.y - v1.y};
+	output[output_index] = sum;
+	output[output_index + pass_size] = diff;
+}
+
+
+kernel void multiply_fft_spectra(global float2 *spectra, int stations_count,
+								 int base_station_index, int block_length,
+								 int fft_size){
+	// Station spectra are replaced with conj(base spectrum) * spectrum,
+	// the inverse transform of which is the cross-correlation by delays.
+	int global_id = get_global_thread_id();
+	if (global_id > block_length * stations_count * fft_size - 1){
+		return;
+	}
+
+	int block_time_index = global_id / (stations_count * fft_size);
+	int station_index = (global_id / fft_size) % stations_count;
+	int sample_index = global_id % fft_size;
+
+	if (station_index == base_station_index){
+		return;
+	}
+
+	float2 a = spectra[(block_time_index * stations_count + base_station_index) * fft_size + sample_index];
+	float2 b = spectra[global_id];
+
+	float2 product = {
+		a.x * b.x + a.y * b.y,
+		a.x * b.y - a.y * b.x
+	};
+	spectra[global_id] = product;
+}
+
+
+kernel void select_fft_delays(global const float2 *cross_correlations,
+							  global const float *signals, int signal_length,
+							  int stations_count, int scanner_size,
+							  int window_size, float min_correlation,
+							  int base_station_index, int start_time_index,
+							  int block_length, int processing_length,
+							  int fft_size, global int *real_delays){
+	int block_time_index = get_global_thread_id();
+	int time_index = start_time_index + block_time_index;
+
+	if ((block_time_index > block_length - 1) || (time_index > processing_length - 1)){
+		return;
+	}
+
+	int base_signal_index = base_station_index * signal_length + time_index;
+
+	float sum_a = 0;
+	float sum_qa = 0;
+	int base_repeats_count = 0;
+	for (int j = 0; j < window_size; j++){
+		float val_a = signals[base_signal_index + j];
+		sum_a += val_a;
+		sum_qa += pown(val_a, 2);
+		if (j > 0){
+			base_repeats_count += val_a == signals[base_signal_index + j - 1];
+		}
+	}
+
+	int selection_stations_count = 0;
+	for (int station_index = 0; station_index < stations_count; station_index++){
+		if (station_index == base_station_index){
+			real_delays[time_index * (stations_count + 1) + station_index + 1] = 0;
+			continue;
+		}
+
+		int current_signal_index = station_index * signal_length + time_index;
+		int correlations_index = (block_time_index * stations_count + station_index) * fft_size;
+
+		float sum_b = 0;
+		float sum_qb = 0;
+		int current_repeats_count = 0;
+		for (int j = 0; j < window_size; j++){
+			float val_b = signals[current_signal_index + j];
+			sum_b += val_b;
+			sum_qb += pown(val_b, 2);
+			if (j > 0){
+				current_repeats_count += val_b == signals[current_signal_index + j - 1];
+			}
+		}
+
+		float max_value_correlation = -1;
+		int optimal_delay = NULL_VALUE;
+		for (int delay_index = 0; delay_index < scanner_size; delay_index++){
+			if (delay_index > 0){
+				float out_b = signals[current_signal_index + delay_index - 1];
+				float in_b = signals[current_signal_index + delay_index + window_size - 1];
+				sum_b += in_b - out_b;
+				sum_qb += pown(in_b, 2) - pown(out_b, 2);
+				current_repeats_count -= signals[current_signal_index + delay_index] == out_b;
+				current_repeats_count += in_b == signals[current_signal_index + delay_index + window_size - 2];
 			}
-			float numerator = sum_ab * window_size - sum_a * sum_b;
-			if (numerator < 0){
+
+			if ((base_repeats_count != 0) || (current_repeats_count != 0)){
 				continue;
 			}
 
-			float denominator =  sqrt((sum_qa * window_size - pown(sum_a, 2)) * (sum_qb * window_size - pown(sum_b, 2)));
-			if (denominator == 0){
+			float sum_ab = cross_correlations[correlations_index + delay_index].x / fft_size;
+			float corr = get_correlation(sum_a, sum_qa, sum_b, sum_qb, sum_ab, window_size);
+			if (corr == NULL_VALUE){
 				continue;
 			}
-			
-			float corr = numerator / denominator;
 
 			if ((min_correlation <= corr) && (max_value_correlation < corr)){
 				max_value_correlation = corr;
@@ -117,3 +566,364 @@ kernel void get_real_delays(global const float *signals, int signal_length,
 		real_delays[time_index * (stations_count + 1)] = 0;
 	}
 }
+
+
+kernel void get_real_delays_tiled(global const float *signals, int signal_length,
+								  int stations_count, int scanner_size,
+								  int window_size, float min_correlation,
+								  int base_station_index, int delays_tile_size,
+								  local float *base_span,
+								  local float *station_span,
+								  global int *real_delays){
+	// A work-group owns a block of neighbouring time indices. The base
+	// span and, tile by tile of delays, the station span covering all
+	// windows of the block are staged in local memory once and shared
+	// by all work-items of the group.
+	int local_id = get_local_id(0);
+	int group_size = get_local_size(0);
+	int first_time_index = get_group_id(0) * group_size;
+	int time_index = first_time_index + local_id;
+	bool is_active = time_index < signal_length - window_size - scanner_size;
+
+	int base_span_size = group_size + window_size - 1;
+	for (int i = local_id; i < base_span_size; i += group_size){
+		int signal_index = first_time_index + i;
+		if (signal_index < signal_length){
+			base_span[i] = signals[base_station_index * signal_length + signal_index];
+		}
+		else{
+			base_span[i] = 0;
+		}
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	float sum_a = 0;
+	float sum_qa = 0;
+	float min_value = 0;
+	float max_value = 0;
+	int repeats_count = 0;
+	if (is_active){
+		for (int i = 0; i < window_size; i++){
+			float val = base_span[local_id + i];
+			min_value = min(min_value, val);
+			max_value = max(max_value, val);
+			sum_a += val;
+			sum_qa += pown(val, 2);
+			if (i > 0){
+				repeats_count += val == base_span[local_id + i - 1];
+			}
+		}
+	}
+	bool is_good_base = is_active && (repeats_count == 0) && (min_value != max_value);
+
+	int selection_stations_count = 0;
+	for (int station_index = 0; station_index < stations_count; station_index++){
+		if (station_index == base_station_index){
+			continue;
+		}
+
+		float max_value_correlation = -1;
+		int optimal_delay = NULL_VALUE;
+		for (int first_delay_index = 0; first_delay_index < scanner_size; first_delay_index += delays_tile_size){
+			int tile_size = min(delays_tile_size, scanner_size - first_delay_index);
+			int station_span_size = group_size + window_size + tile_size - 2;
+
+			barrier(CLK_LOCAL_MEM_FENCE);
+			for (int i = local_id; i < station_span_size; i += group_size){
+				int signal_index = first_time_index + first_delay_index + i;
+				if (signal_index < signal_length){
+					station_span[i] = signals[station_index * signal_length + signal_index];
+				}
+				else{
+					station_span[i] = 0;
+				}
+			}
+			barrier(CLK_LOCAL_MEM_FENCE);
+
+			if (!is_good_base){
+				continue;
+			}
+
+			for (int tile_delay_index = 0; tile_delay_index < tile_size; tile_delay_index++){
+				int span_index = local_id + tile_delay_index;
+
+				float sum_b = 0;
+				float sum_qb = 0;
+				float sum_ab = 0;
+				int current_repeats_count = 0;
+				for (int j = 0; j < window_size; j++){
+					float val_a = base_span[local_id + j];
+					float val_b = station_span[span_index + j];
+					sum_b += val_b;
+					sum_qb += pown(val_b, 2);
+					sum_ab += val_a * val_b;
+					if (j > 0){
+						current_repeats_count += val_b == station_span[span_index + j - 1];
+					}
+				}
+				if (current_repeats_count != 0){
+					continue;
+				}
+
+				float corr = get_correlation(sum_a, sum_qa, sum_b, sum_qb, sum_ab, window_size);
+				if (corr == NULL_VALUE){
+					continue;
+				}
+
+				if ((min_correlation <= corr) && (max_value_correlation < corr)){
+					max_value_correlation = corr;
+					optimal_delay = first_delay_index + tile_delay_index;
+				}
+			}
+		}
+
+		if (is_active){
+			real_delays[time_index * (stations_count + 1) + station_index + 1] = optimal_delay;
+		}
+		if (optimal_delay != NULL_VALUE){
+			selection_stations_count++;
+		}
+	}
+
+	if (!is_active){
+		return;
+	}
+
+	real_delays[time_index * (stations_count + 1) + base_station_index + 1] = 0;
+	if (selection_stations_count > MIN_STATIONS_COUNT){
+		real_delays[time_index * (stations_count + 1)] = 1;
+	}
+	else{
+		real_delays[time_index * (stations_count + 1)] = 0;
+	}
+}
+
+
+kernel void get_station_delays(global const float *signals,
+							   global const int *repeats_prefix, int signal_length,
+							   int stations_count, int scanner_size,
+							   int window_size, float min_correlation,
+							   int base_station_index,
+							   global int *real_delays){
+	// NDRange is (time index, station), so the device is saturated by
+	// many stations even on short signals. The selection flag column is
+	// filled afterwards by count_selected_stations.
+	int time_index = get_global_id(0);
+	int station_index = get_global_id(1);
+
+	if ((time_index > signal_length - window_size - scanner_size - 1) || (station_index > stations_count - 1)){
+		return;
+	}
+
+	int delay_index = time_index * (stations_count + 1) + station_index + 1;
+	if (station_index == base_station_index){
+		real_delays[delay_index] = 0;
+		return;
+	}
+
+	int base_signal_index = base_station_index * signal_length + time_index;
+
+	float sum_a = 0;
+	float sum_qa = 0;
+	if (!get_base_window_sums(signals, repeats_prefix, base_signal_index, window_size, &sum_a, &sum_qa)){
+		real_delays[delay_index] = NULL_VALUE;
+		return;
+	}
+
+	real_delays[delay_index] = get_optimal_delay(
+		signals, repeats_prefix, base_signal_index,
+		station_index * signal_length + time_index, scanner_size,
+		window_size, min_correlation, sum_a, sum_qa
+	);
+}
+
+
+kernel void count_selected_stations(int processing_length, int stations_count,
+									int base_station_index,
+									global int *real_delays){
+	int time_index = get_global_thread_id();
+
+	if (time_index > processing_length - 1){
+		return;
+	}
+
+	int selection_stations_count = 0;
+	for (int station_index = 0; station_index < stations_count; station_index++){
+		if (station_index == base_station_index){
+			continue;
+		}
+		if (real_delays[time_index * (stations_count + 1) + station_index + 1] != NULL_VALUE){
+			selection_stations_count++;
+		}
+	}
+
+	if (selection_stations_count > MIN_STATIONS_COUNT){
+		real_delays[time_index * (stations_count + 1)] = 1;
+	}
+	else{
+		real_delays[time_index * (stations_count + 1)] = 0;
+	}
+}
+
+
+kernel void compact_real_delays(global const int *real_delays,
+								int processing_length, int stations_count,
+								int accepted_capacity,
+								volatile global int *accepted_count,
+								global int *accepted_delays){
+	// Accepted rows are appended as (time index, delays...) in arbitrary
+	// order, so only accepted_count rows have to be read back. Rows over
+	// the capacity are only counted, so the host sees the overflow.
+	int time_index = get_global_thread_id();
+
+	if (time_index > processing_length - 1){
+		return;
+	}
+
+	int row_index = time_index * (stations_count + 1);
+	if (real_delays[row_index] != 1){
+		return;
+	}
+
+	int accepted_row_index = atomic_inc(accepted_count);
+	if (accepted_row_index > accepted_capacity - 1){
+		return;
+	}
+
+	int accepted_index = accepted_row_index * (stations_count + 1);
+	accepted_delays[accepted_index] = time_index;
+	for (int station_index = 0; station_index < stations_count; station_index++){
+		accepted_delays[accepted_index + station_index + 1] = real_delays[row_index + station_index + 1];
+	}
+}
+
+
+kernel void get_similarity_masks(global const int *accepted_delays,
+								 int rows_count, int stations_count,
+								 int scanner_size, int time_epsilon,
+								 int min_similar_count, int masks_count,
+								 global uint *similarity_masks){
+	// Bit k of the row masks marks that row i + k + 1 is similar to row i.
+	// Values differ by no more than time_epsilon or one of them is NULL.
+	int global_id = get_global_thread_id();
+
+	if (global_id > rows_count * masks_count - 1){
+		return;
+	}
+
+	int row_index = global_id / masks_count;
+	int first_offset = (global_id % masks_count) * 32 + 1;
+	int row_a_index = row_index * (stations_count + 1) + 1;
+
+	uint mask = 0;
+	for (int bit_index = 0; bit_index < 32; bit_index++){
+		int offset = first_offset + bit_index;
+		if ((offset > scanner_size) || (row_index + offset > rows_count - 1)){
+			break;
+		}
+
+		int row_b_index = (row_index + offset) * (stations_count + 1) + 1;
+		int similar_count = 0;
+		for (int station_index = 0; station_index < stations_count; station_index++){
+			int diff = abs(accepted_delays[row_a_index + station_index] - accepted_delays[row_b_index + station_index]);
+			if ((diff <= time_epsilon) || (diff > abs(NULL_VALUE) / 2)){
+				similar_count++;
+			}
+		}
+		if (similar_count >= min_similar_count){
+			mask |= 1u << bit_index;
+		}
+	}
+	similarity_masks[global_id] = mask;
+}
+
+
+kernel void select_distinct_delays(global const uint *similarity_masks,
+								   int rows_count, int scanner_size,
+								   int masks_count,
+								   volatile local int *duration_index,
+								   global int *durations){
+	// Greedy selection must visit rows in order, so a single work-group
+	// walks them and splits the scanner window of each selected row
+	// between its work-items. Skipped rows are marked with NULL_VALUE.
+	int local_id = get_local_id(0);
+	int group_size = get_local_size(0);
+
+	for (int i = local_id; i < rows_count; i += group_size){
+		durations[i] = 0;
+	}
+	barrier(CLK_GLOBAL_MEM_FENCE);
+
+	for (int i = 0; i < rows_count; i++){
+		if (durations[i] == NULL_VALUE){
+			continue;
+		}
+
+		if (local_id == 0){
+			*duration_index = i;
+		}
+		barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+
+		for (int offset = local_id + 1; offset <= scanner_size; offset += group_size){
+			int j = i + offset;
+			if (j > rows_count - 1){
+				break;
+			}
+			uint mask = similarity_masks[i * masks_count + (offset - 1) / 32];
+			if ((durations[j] != NULL_VALUE) && ((mask >> ((offset - 1) % 32)) & 1u)){
+				durations[j] = NULL_VALUE;
+				atomic_max(duration_index, j);
+			}
+		}
+		barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
+
+		if (local_id == 0){
+			durations[i] = *duration_index - i;
+		}
+	}
+}
+
+
+kernel void append_ring_samples(global const float *samples, int block_length,
+								int samples_count, int stations_count,
+								int ring_length, int first_ring_index,
+								global float *ring){
+	// Every sample is stored twice, ring_length apart, so the last
+	// ring_length samples are contiguous in memory from any ring index.
+	int global_id = get_global_thread_id();
+
+	if (global_id > stations_count * samples_count - 1){
+		return;
+	}
+
+	int station_index = global_id / samples_count;
+	int sample_index = global_id % samples_count;
+
+	float value = samples[station_index * block_length + sample_index];
+	int ring_index = station_index * 2 * ring_length + (first_ring_index + sample_index) % ring_length;
+	ring[ring_index] = value;
+	ring[ring_index + ring_length] = value;
+}
+
+
+kernel void get_ring_delays(global const float *ring,
+							global const int *repeats_prefix, int ring_length,
+							int stations_count, int scanner_size,
+							int window_size, float min_correlation,
+							int base_station_index, int first_ring_index,
+							int times_count, global int *real_delays){
+	int time_index = get_global_thread_id();
+
+	if (time_index > times_count - 1){
+		return;
+	}
+
+	// rows are not wrapped, the repeats prefix is filled only over the
+	// ring indexes read by these rows
+	find_row_delays(
+		ring, repeats_prefix, 2 * ring_length, stations_count, scanner_size,
+		window_size, min_correlation, base_station_index,
+		first_ring_index + time_index,
+		real_delays + time_index * (get_stations_count(stations_count) + 1)
+	);
+}
@@ -1,10 +1,45 @@
 #define NULL_VALUE -9999
-#define MODEL_COLUMNS_COUNT 3
+// model rows are (bottom, top, vp, thickness, 1 / vp, vertical time from
+// the model top to the layer top) from the top layer down
+#define MODEL_COLUMNS_COUNT 6
+#define THICKNESS_COLUMN 3
+#define SLOWNESS_COLUMN 4
+#define VERTICAL_TIME_COLUMN 5
 #define COORDINATE_COLUMNS_COUNT 2
 #define SEARCH_ORIGINS_COLUMNS_COUNT 3
+#define ELLIPSOID_COLUMNS_COUNT 10
+#define MISFITS_EVENTS_COUNT 8
+#ifndef MAX_ITERATIONS_COUNT
 #define MAX_ITERATIONS_COUNT 10
+#endif
+#ifndef NEWTON_MAX_ITERATIONS_COUNT
+#define NEWTON_MAX_ITERATIONS_COUNT 20
+#endif
+#define BISECTION_RAY_SOLVER 0
+#define NEWTON_RAY_SOLVER 1
+#ifndef RAY_SOLVER
+#define RAY_SOLVER BISECTION_RAY_SOLVER
+#endif
 #define POSITIVE_DIRECTION 1
 #define NEGATIVE_DIRECTION -1
+// rays are traced in double precision unless single precision rays are
+// selected for cards with slow fp64
+#ifdef SINGLE_PRECISION_RAYS
+typedef float ray_float;
+#define RAY_PI_2 M_PI_2_F
+#else
+typedef double ray_float;
+#define RAY_PI_2 M_PI_2
+#endif
+// the layers count given by build options is a compile-time constant, so
+// loops over layers of a ray can be fully unrolled
+#ifdef LAYERS_COUNT
+#define get_layers_count(layers_count) LAYERS_COUNT
+#define UNROLL_LAYERS _Pragma("unroll")
+#else
+#define get_layers_count(layers_count) (layers_count)
+#define UNROLL_LAYERS
+#endif
 
 
 int get_global_thread_id(){
@@ -14,29 +49,40 @@ int get_global_thread_id(){
 }
 
 
-int get_model_layer_index_by_altitude(global const float *model,
+int get_model_layer_index_by_altitude(constant float *model,
 								      int layers_count,
 								      float target_altitude){
-	for (int i=0; i < layers_count; i++){
-		float bottom_altitude = model[MODEL_COLUMNS_COUNT * i];
-		float top_altitude = model[MODEL_COLUMNS_COUNT * i + 1];
-
-		if ((bottom_altitude <= target_altitude) && (target_altitude < top_altitude)){
-			return i;
+	// bottoms decrease with index, the first layer with bottom not above
+	// the altitude is found by binary search
+	int low_index = 0;
+	int high_index = get_layers_count(layers_count) - 1;
+	while (low_index < high_index){
+		int middle_index = (low_index + high_index) / 2;
+		if (model[MODEL_COLUMNS_COUNT * middle_index] <= target_altitude){
+			high_index = middle_index;
+		}
+		else{
+			low_index = middle_index + 1;
 		}
 	}
+
+	float bottom_altitude = model[MODEL_COLUMNS_COUNT * low_index];
+	float top_altitude = model[MODEL_COLUMNS_COUNT * low_index + 1];
+	if ((bottom_altitude <= target_altitude) && (target_altitude < top_altitude)){
+		return low_index;
+	}
 	return NULL_VALUE;
 }
 
 
-double get_ray_constant(double incident_angle, float vp){
+ray_float get_ray_constant(ray_float incident_angle, float vp){
 	return sin(incident_angle) / vp;
 }
 
 
-bool is_ray_reflected(global const float *model, int layers_count,
+bool is_ray_reflected(constant float *model, int layers_count,
                       float source_altitude, float target_altitude,
-                      double incident_angle){
+                      ray_float incident_angle){
 	int source_layer_index = get_model_layer_index_by_altitude(model, layers_count, source_altitude);
 	int target_layer_index = get_model_layer_index_by_altitude(model, layers_count, target_altitude);
 
@@ -44,9 +90,13 @@ bool is_ray_reflected(global const float *model, int layers_count,
 		return true;
 	}
 
-	double ray_constant = get_ray_constant(incident_angle, model[source_layer_index * MODEL_COLUMNS_COUNT + 2]);
-	for (int i=source_layer_index; i > target_layer_index - 1; i--){
-		if (ray_constant * model[i * layers_count + 2] > 1){
+	ray_float ray_constant = get_ray_constant(incident_angle, model[source_layer_index * MODEL_COLUMNS_COUNT + 2]);
+	UNROLL_LAYERS
+	for (int i = get_layers_count(layers_count) - 1; i >= 0; i--){
+		if ((i > source_layer_index) || (i < target_layer_index)){
+			continue;
+		}
+		if (ray_constant * model[i * MODEL_COLUMNS_COUNT + 2] > 1){
 			return true;
 		}
 	}
@@ -54,9 +104,9 @@ bool is_ray_reflected(global const float *model, int layers_count,
 }
 
 
-float3 get_ray_trace(global const float *model, int layers_count,
+float3 get_ray_trace(constant float *model, int layers_count,
 				     float source_r, float source_altitude, float target_altitude,
-                     double incident_angle, int lateral_direction,
+                     ray_float incident_angle, int lateral_direction,
                      int frequency){
 	float3 last_trace_point = {NULL_VALUE, NULL_VALUE, NULL_VALUE};
 	if (is_ray_reflected(model, layers_count, source_altitude,
@@ -71,8 +121,13 @@ float3 get_ray_trace(global const float *model, int layers_count,
 	last_trace_point.s1 = source_altitude;
 	last_trace_point.s2 = 0;
 
-	double ray_constant = get_ray_constant(incident_angle, model[source_layer_index * MODEL_COLUMNS_COUNT + 2]);
-	for (int i=source_layer_index; i > target_layer_index - 1; i--){
+	ray_float ray_constant = get_ray_constant(incident_angle, model[source_layer_index * MODEL_COLUMNS_COUNT + 2]);
+	UNROLL_LAYERS
+	for (int i = get_layers_count(layers_count) - 1; i >= 0; i--){
+		if ((i > source_layer_index) || (i < target_layer_index)){
+			continue;
+		}
+
 		float thickness = 0;
 		if (i == source_layer_index){
 			thickness = model[i * MODEL_COLUMNS_COUNT + 1] - source_altitude;
@@ -81,15 +136,23 @@ float3 get_ray_trace(global const float *model, int layers_count,
 			thickness = target_altitude - model[i * MODEL_COLUMNS_COUNT];
 		}
 		else{
-			thickness = model[i * MODEL_COLUMNS_COUNT + 1] - model[i * MODEL_COLUMNS_COUNT];
+			thickness = model[i * MODEL_COLUMNS_COUNT + THICKNESS_COLUMN];
 		}
 
-		double refraction_angle = asin(ray_constant * model[i * MODEL_COLUMNS_COUNT + 2]);
+#ifdef SINGLE_PRECISION_RAYS
+		// tangent of the refraction angle by its sine
+		ray_float refraction_sine = ray_constant * model[i * MODEL_COLUMNS_COUNT + 2];
+		float dr_offset = thickness * refraction_sine / sqrt(
+			1 - refraction_sine * refraction_sine
+		) * lateral_direction;
+#else
+		ray_float refraction_angle = asin(ray_constant * model[i * MODEL_COLUMNS_COUNT + 2]);
 
 		float dr_offset = thickness * tan(refraction_angle) * lateral_direction;
+#endif
 
 		float dl = sqrt(pown(dr_offset, 2) + pown(thickness, 2));
-		float dt = dl / model[i * MODEL_COLUMNS_COUNT + 2];
+		float dt = dl * model[i * MODEL_COLUMNS_COUNT + SLOWNESS_COLUMN];
 
 		last_trace_point.s0 += dr_offset;
 		last_trace_point.s1 += thickness;
@@ -99,27 +162,30 @@ float3 get_ray_trace(global const float *model, int layers_count,
 }
 
 
-double get_min_angle(float delta_altitudes, float accuracy){
-	return atan2((double) 0.5 * accuracy, (double) delta_altitudes);
+ray_float get_min_angle(float delta_altitudes, float accuracy){
+	return atan2((ray_float) accuracy / 2, (ray_float) delta_altitudes);
 }
 
 
-double get_max_angle(float delta_altitudes, float r_offset){
-	return atan2((double) r_offset, (double) delta_altitudes);
+ray_float get_max_angle(float delta_altitudes, float r_offset){
+	return atan2((ray_float) r_offset, (ray_float) delta_altitudes);
 }
 
 
-int get_ray_time(global const float *model, int layers_count,
-				   float source_r, float source_altitude,
-				   float receiver_r, float receiver_altitude,
-				   float accuracy, int frequency){
+float get_bisection_ray_time(constant float *model, int layers_count,
+							 float source_r, float source_altitude,
+							 float receiver_r, float receiver_altitude,
+							 float accuracy, int frequency){
 	float delta_altitudes = fabs(source_altitude - receiver_altitude);
-	double min_angle = get_min_angle(delta_altitudes, accuracy);
+	ray_float min_angle = get_min_angle(delta_altitudes, accuracy);
 
 	int source_layer_index = get_model_layer_index_by_altitude(model, layers_count, source_altitude);
+	if (source_layer_index == NULL_VALUE){
+		return NULL_VALUE;
+	}
 	float layer_delta_altitudes = model[source_layer_index * MODEL_COLUMNS_COUNT + 1] - source_altitude;
 	float r_offset = fabs(source_r - receiver_r);
-	double max_angle = get_max_angle(layer_delta_altitudes, r_offset);
+	ray_float max_angle = get_max_angle(layer_delta_altitudes, r_offset);
 
 	int lateral_direction = 0;
 	if (receiver_r >= 0){
@@ -142,10 +208,10 @@ int get_ray_time(global const float *model, int layers_count,
 
         float dr = fabs(min_ray.s0 - receiver_r);
         if (dr < accuracy){
-        	return (int)min_ray.s2;
+        	return min_ray.s2;
         }
 
-        double middle_angle = (min_angle + max_angle) / 2;
+        ray_float middle_angle = (min_angle + max_angle) / 2;
 
         float3 middle_ray = get_ray_trace(
 			model, layers_count, source_r, source_altitude, receiver_altitude,
@@ -154,7 +220,7 @@ int get_ray_time(global const float *model, int layers_count,
 
         dr = fabs(middle_ray.s0 - receiver_r);
         if (dr < accuracy){
-        	return (int)middle_ray.s2;
+        	return middle_ray.s2;
         }
 
         float3 max_ray = get_ray_trace(
@@ -164,7 +230,7 @@ int get_ray_time(global const float *model, int layers_count,
 
         dr = fabs(max_ray.s0 - receiver_r);
         if (dr < accuracy){
-        	return (int)max_ray.s2;
+        	return max_ray.s2;
         }
 
         if (lateral_direction == POSITIVE_DIRECTION){
@@ -194,7 +260,131 @@ int get_ray_time(global const float *model, int layers_count,
 }
 
 
-float get_diff_function(global const float *model, int layers_count,
+float3 get_ray_parameter_trace(constant float *model,
+							   int lower_layer_index, int upper_layer_index,
+							   float lower_altitude, float upper_altitude,
+							   ray_float ray_parameter, int frequency){
+	// horizontal offset, time and derivative of offset by ray parameter
+	// p = sin(angle) / vp are sums over layers between the altitudes
+	ray_float offset = 0;
+	ray_float time = 0;
+	ray_float offset_derivative = 0;
+	for (int i = lower_layer_index; i > upper_layer_index - 1; i--){
+		float bottom_altitude = fmax(model[i * MODEL_COLUMNS_COUNT], lower_altitude);
+		float top_altitude = fmin(model[i * MODEL_COLUMNS_COUNT + 1], upper_altitude);
+		ray_float thickness = top_altitude - bottom_altitude;
+		ray_float vp = model[i * MODEL_COLUMNS_COUNT + 2];
+
+		ray_float cosine = sqrt(1 - pown(ray_parameter * vp, 2));
+		offset += thickness * ray_parameter * vp / cosine;
+		time += thickness * model[i * MODEL_COLUMNS_COUNT + SLOWNESS_COLUMN] / cosine;
+		offset_derivative += thickness * vp / pown(cosine, 3);
+	}
+
+	float3 trace = {offset, time * frequency, offset_derivative};
+	return trace;
+}
+
+
+float get_vertical_time(constant float *model, int layer_index,
+						float altitude){
+	// time of the vertical ray from the model top down to the altitude
+	return model[layer_index * MODEL_COLUMNS_COUNT + VERTICAL_TIME_COLUMN] + (
+		model[layer_index * MODEL_COLUMNS_COUNT + 1] - altitude
+	) * model[layer_index * MODEL_COLUMNS_COUNT + SLOWNESS_COLUMN];
+}
+
+
+float get_max_layers_vp(constant float *model, int lower_layer_index,
+						int upper_layer_index){
+	float max_vp = 0;
+	for (int i = lower_layer_index; i > upper_layer_index - 1; i--){
+		max_vp = fmax(max_vp, model[i * MODEL_COLUMNS_COUNT + 2]);
+	}
+	return max_vp;
+}
+
+
+float get_newton_ray_time(constant float *model, int layers_count,
+						  float source_r, float source_altitude,
+						  float receiver_r, float receiver_altitude,
+						  float accuracy, int frequency){
+	float lower_altitude = fmin(source_altitude, receiver_altitude);
+	float upper_altitude = fmax(source_altitude, receiver_altitude);
+	int lower_layer_index = get_model_layer_index_by_altitude(model, layers_count, lower_altitude);
+	int upper_layer_index = get_model_layer_index_by_altitude(model, layers_count, upper_altitude);
+	if ((lower_layer_index == NULL_VALUE) || (upper_layer_index == NULL_VALUE)){
+		return NULL_VALUE;
+	}
+
+	float r_offset = fabs(receiver_r - source_r);
+	if (r_offset < accuracy){
+		return (get_vertical_time(model, lower_layer_index, lower_altitude) -
+				get_vertical_time(model, upper_layer_index, upper_altitude)) * frequency;
+	}
+
+	float max_vp = get_max_layers_vp(model, lower_layer_index, upper_layer_index);
+
+	// offset grows monotonically with p in [0, 1 / max vp), so the root
+	// stays bracketed and Newton steps out of the bracket are bisected
+	ray_float min_parameter = 0;
+	ray_float max_parameter = (ray_float)1 / max_vp;
+	ray_float ray_parameter = r_offset / (hypot(r_offset, upper_altitude - lower_altitude) * max_vp);
+	if (!(ray_parameter < max_parameter)){
+		ray_parameter = max_parameter / 2;
+	}
+
+	for (int i = 0; i < NEWTON_MAX_ITERATIONS_COUNT; i++){
+		float3 trace = get_ray_parameter_trace(
+			model, lower_layer_index, upper_layer_index, lower_altitude,
+			upper_altitude, ray_parameter, frequency
+		);
+
+		float dr = trace.s0 - r_offset;
+		if (fabs(dr) < accuracy){
+			return trace.s1;
+		}
+
+		if (dr < 0){
+			min_parameter = ray_parameter;
+		}
+		else{
+			max_parameter = ray_parameter;
+		}
+
+		ray_parameter -= dr / trace.s2;
+		if (!((min_parameter < ray_parameter) && (ray_parameter < max_parameter))){
+			ray_parameter = (min_parameter + max_parameter) / 2;
+		}
+	}
+	return NULL_VALUE;
+}
+
+
+float get_ray_float_time(constant float *model, int layers_count,
+						 float source_r, float source_altitude,
+						 float receiver_r, float receiver_altitude,
+						 float accuracy, int frequency){
+#if RAY_SOLVER == NEWTON_RAY_SOLVER
+	return get_newton_ray_time(model, layers_count, source_r, source_altitude,
+		receiver_r, receiver_altitude, accuracy, frequency);
+#else
+	return get_bisection_ray_time(model, layers_count, source_r,
+		source_altitude, receiver_r, receiver_altitude, accuracy, frequency);
+#endif
+}
+
+
+int get_ray_time(constant float *model, int layers_count,
+				   float source_r, float source_altitude,
+				   float receiver_r, float receiver_altitude,
+				   float accuracy, int frequency){
+	return (int)get_ray_float_time(model, layers_count, source_r,
+		source_altitude, receiver_r, receiver_altitude, accuracy, frequency);
+}
+
+
+float get_diff_function(constant float *model, int layers_count,
 	global const int *real_delays, int stations_count, int events_count,
 	int event_id, global const float *station_coordinates,
 	float stations_altitude, float3 node_coordinate, float accuracy,
@@ -259,174 +449,1454 @@ float get_diff_function(global const float *model, int layers_count,
 }
 
 
-kernel void get_diff_function_cube(global const float *model,
-	int layers_count, global const int *real_delays, int stations_count, int
-	events_count, global const float *station_coordinates,
-	float stations_altitude,
-	global const float *search_origins,
-	float dx, float dy, float dz,
-	int nx, int ny, int nz, float accuracy, int frequency,
-	int base_station_index, global float *diff_func_cube_values
+float get_pruned_diff_function(constant float *model, int layers_count,
+	global const int *real_delays, int stations_count, int event_id,
+	global const float *station_coordinates, float stations_altitude,
+	float3 node_coordinate, float accuracy, int frequency,
+	int base_station_index, volatile global int *best_values
 ){
-	int global_id = get_global_thread_id();
-	int all_nodes_count = nx * ny * nz;
-	if (global_id > all_nodes_count * events_count - 1){
-		return;
-	}
-
-	int event_id = global_id / (nx * ny * nz);
-	int node_id = global_id % (nx * ny * nz);
-
-	int3 node_index = {
-		(node_id % (nx * ny)) % nx,
-		(node_id % (nx * ny)) / nx,
-		node_id / (nx * ny)
-	};
-
-	float3 node_coordinate = {
-		node_index.s0 * dx + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT],
-		node_index.s1 * dy + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 1],
-		node_index.s2 * dz + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 2]
+	// get_diff_function which stops once its lower bound exceeds the best
+	// value of the event, the bound is returned then; best values are
+	// non-negative floats, so their bits are ordered like integers
+	float2 base_coordinate = {
+		station_coordinates[base_station_index * COORDINATE_COLUMNS_COUNT],
+		station_coordinates[base_station_index * COORDINATE_COLUMNS_COUNT + 1]
 	};
 
-	float min_model_altitude = model[(layers_count - 1) * MODEL_COLUMNS_COUNT];
-	float max_model_altitude = model[1];
-
+	float offset = sqrt(
+		pown(base_coordinate.s0 - node_coordinate.s0, 2) +
+		pown(base_coordinate.s1 - node_coordinate.s1, 2)
+	);
 
-	if (node_coordinate.s2 < min_model_altitude){
-		diff_func_cube_values[global_id] = NULL_VALUE;
-	}
-	else if (node_coordinate.s2 > max_model_altitude){
-		diff_func_cube_values[global_id] = NULL_VALUE;
-	}
-	else{
-		diff_func_cube_values[global_id] = get_diff_function(
-			model, layers_count, real_delays, stations_count, events_count,
-			event_id, station_coordinates, stations_altitude, node_coordinate,
-			accuracy, frequency, base_station_index
-		);
+	int base_time = get_ray_time(model, layers_count, 0, node_coordinate.s2,
+								   offset, stations_altitude, accuracy,
+								   frequency);
+	if (base_time == NULL_VALUE){
+		return NULL_VALUE;
 	}
-}
-
 
-kernel void get_minimal_nodes(global float *diff_func_values,
-							 int nodes_count, int events_count,
-							 global int *minimal_nodes,
-							 global float *error){
-	int global_id = get_global_thread_id();
+	float diff_function_value = 0;
+	int using_stations_count = 0;
+	for (int i=0; i < stations_count; i++){
+		// value is not less than the partial sum over all stations
+		float lower_bound = sqrt(diff_function_value) / stations_count;
+		if (lower_bound > as_float(best_values[event_id])){
+			return lower_bound;
+		}
 
-	if (global_id > events_count - 1){
-		return;
-	}
+		float2 coordinate = {
+			station_coordinates[i * COORDINATE_COLUMNS_COUNT],
+			station_coordinates[i * COORDINATE_COLUMNS_COUNT + 1]
+		};
 
-	int min_node_id = global_id * nodes_count;
+		offset = sqrt(
+			pown(coordinate.s0 - node_coordinate.s0, 2) +
+			pown(coordinate.s1 - node_coordinate.s1, 2)
+		);
 
-	int minimal_node = NULL_VALUE;
-	float min_diff_function = INFINITY;
-	for (int i = 0; i < nodes_count; i++){
-		float diff_func_value = diff_func_values[min_node_id + i];
-		if (diff_func_value == NULL_VALUE){
+		int time = get_ray_time(model, layers_count, 0, node_coordinate.s2,
+								offset, stations_altitude, accuracy,
+								frequency);
+		if (time == NULL_VALUE){
 			continue;
 		}
-		if (diff_func_value < min_diff_function){
-			min_diff_function = diff_func_value;
-			minimal_node = i;
+
+		int theor_time_diff = time - base_time;
+
+		if (theor_time_diff < 0){
+			continue;
 		}
+
+		int real_time_diff = real_delays[event_id * stations_count + i];
+		int delta_diff = theor_time_diff - real_time_diff;
+		diff_function_value += delta_diff * delta_diff;
+		using_stations_count++;
 	}
 
-	minimal_nodes[global_id] = minimal_node;
-	error[global_id] = min_diff_function;
-}
+	if (using_stations_count < 3){
+		return NULL_VALUE;
+	}
 
+	float value = sqrt(diff_function_value) / using_stations_count;
+	atomic_min(&best_values[event_id], as_int(value));
+	return value;
+}
 
-kernel void test_get_model_layer_index_by_altitude(
-	global const float *model, int layers_count, float target_altitude
-	){
-	int global_id = get_global_thread_id();
 
-	if (global_id > 0){
-		return;
+float get_column_diff_function(constant float *model, int layers_count,
+	global const int *real_delays, int stations_count, int event_id,
+	local const float *offsets, float stations_altitude,
+	float node_altitude, float accuracy, int frequency,
+	int base_station_index
+){
+	// get_diff_function with lateral offsets of the node column
+	int base_time = get_ray_time(model, layers_count, 0, node_altitude,
+								 offsets[base_station_index],
+								 stations_altitude, accuracy, frequency);
+	if (base_time == NULL_VALUE){
+		return NULL_VALUE;
 	}
 
-	int index = get_model_layer_index_by_altitude(
-		model, layers_count, target_altitude
-	);
+	float diff_function_value = 0;
+	int using_stations_count = 0;
+	for (int i=0; i < stations_count; i++){
+		int time = get_ray_time(model, layers_count, 0, node_altitude,
+								offsets[i], stations_altitude, accuracy,
+								frequency);
+		if (time == NULL_VALUE){
+			continue;
+		}
 
-	printf("%i\n", index);
-}
+		int theor_time_diff = time - base_time;
 
-kernel void test_get_ray_constant(float incident_angle, float vp){
-	int global_id = get_global_thread_id();
+		if (theor_time_diff < 0){
+			continue;
+		}
 
-	if (global_id > 0){
-		return;
+		int real_time_diff = real_delays[event_id * stations_count + i];
+		int delta_diff = theor_time_diff - real_time_diff;
+		diff_function_value += delta_diff * delta_diff;
+		using_stations_count++;
 	}
 
-	printf("%f\n", get_ray_constant((double)incident_angle, vp));
+	if (using_stations_count < 3){
+		return NULL_VALUE;
+	}
+	return sqrt(diff_function_value) / using_stations_count;
 }
 
-kernel void test_is_ray_reflected(global const float *model,
-	int layers_count, float source_altitude,
-	float target_altitude, float incident_angle
-	){
-    int global_id = get_global_thread_id();
 
-	if (global_id > 0){
-		return;
+float get_table_ray_time(global const float *travel_times,
+						 float min_altitude, float altitude_step,
+						 int altitudes_count, float offset_step,
+						 int offsets_count, float source_altitude,
+						 float offset){
+	float altitude_position = (source_altitude - min_altitude) / altitude_step;
+	float offset_position = offset / offset_step;
+	if ((altitude_position < 0) || (altitude_position > altitudes_count - 1)){
+		return NULL_VALUE;
 	}
-
-	bool is_reflected = is_ray_reflected(model, layers_count, source_altitude,
-	target_altitude, (double)incident_angle
-	);
-
-	if (is_reflected){
-		printf("1\n");
+	if (offset_position > offsets_count - 1){
+		return NULL_VALUE;
 	}
-	else{
-		printf("0\n");
+
+	int altitude_index = min((int)altitude_position, altitudes_count - 2);
+	int offset_index = min((int)offset_position, offsets_count - 2);
+	float altitude_weight = altitude_position - altitude_index;
+	float offset_weight = offset_position - offset_index;
+
+	int cell_index = altitude_index * offsets_count + offset_index;
+	float bottom_left = travel_times[cell_index];
+	float bottom_right = travel_times[cell_index + 1];
+	float top_left = travel_times[cell_index + offsets_count];
+	float top_right = travel_times[cell_index + offsets_count + 1];
+	if ((bottom_left == NULL_VALUE) || (bottom_right == NULL_VALUE) ||
+		(top_left == NULL_VALUE) || (top_right == NULL_VALUE)){
+		return NULL_VALUE;
 	}
+
+	float bottom_time = bottom_left + (bottom_right - bottom_left) * offset_weight;
+	float top_time = top_left + (top_right - top_left) * offset_weight;
+	return bottom_time + (top_time - bottom_time) * altitude_weight;
 }
 
-kernel void test_get_ray_trace(global const float *model, int layers_count,
-	float source_r, float source_altitude, float target_altitude,
-    float incident_angle, int lateral_direction, int frequency
-){
-	int global_id = get_global_thread_id();
 
-	if (global_id > 0){
-		return;
-	}
+float get_table_diff_function(global const float *travel_times,
+	float min_altitude, float altitude_step, int altitudes_count,
+	float offset_step, int offsets_count,
+	global const int *real_delays, int stations_count, int event_id,
+	global const float *station_coordinates, float3 node_coordinate,
+	int base_station_index
+){
+	float2 base_coordinate = {
+		station_coordinates[base_station_index * COORDINATE_COLUMNS_COUNT],
+		station_coordinates[base_station_index * COORDINATE_COLUMNS_COUNT + 1]
+	};
 
-	float3 ray_point = get_ray_trace(
-		model, layers_count, source_r, source_altitude, target_altitude,
-    	(double)incident_angle, lateral_direction, frequency
+	float offset = sqrt(
+		pown(base_coordinate.s0 - node_coordinate.s0, 2) +
+		pown(base_coordinate.s1 - node_coordinate.s1, 2)
 	);
-	printf("%f %f %f\n", ray_point.s0, ray_point.s1, ray_point.s2);
-}
-
-kernel void test_get_min_angle(float delta_altitudes, float accuracy){
-	int global_id = get_global_thread_id();
 
-	if (global_id > 0){
-		return;
+	float base_table_time = get_table_ray_time(
+		travel_times, min_altitude, altitude_step, altitudes_count,
+		offset_step, offsets_count, node_coordinate.s2, offset
+	);
+	if (base_table_time == NULL_VALUE){
+		return NULL_VALUE;
 	}
+	int base_time = (int)base_table_time;
 
-	double min_angle = get_min_angle(delta_altitudes, accuracy);
-	printf("%f\n", min_angle);
-}
+	float diff_function_value = 0;
+	int using_stations_count = 0;
+	for (int i=0; i < stations_count; i++){
+		float2 coordinate = {
+			station_coordinates[i * COORDINATE_COLUMNS_COUNT],
+			station_coordinates[i * COORDINATE_COLUMNS_COUNT + 1]
+		};
 
-kernel void test_get_max_angle(float delta_altitudes, float r_offset){
-	int global_id = get_global_thread_id();
+		offset = sqrt(
+			pown(coordinate.s0 - node_coordinate.s0, 2) +
+			pown(coordinate.s1 - node_coordinate.s1, 2)
+		);
 
-	if (global_id > 0){
-		return;
-	}
+		float table_time = get_table_ray_time(
+			travel_times, min_altitude, altitude_step, altitudes_count,
+			offset_step, offsets_count, node_coordinate.s2, offset
+		);
+		if (table_time == NULL_VALUE){
+			continue;
+		}
 
-	double max_angle = get_max_angle(delta_altitudes, r_offset);
-	printf("%f\n", max_angle);
-}
+		int theor_time_diff = (int)table_time - base_time;
 
-kernel void test_get_ray_time(global const float *model, int layers_count,
+		if (theor_time_diff < 0){
+			continue;
+		}
+
+		int real_time_diff = real_delays[event_id * stations_count + i];
+		int delta_diff = theor_time_diff - real_time_diff;
+		diff_function_value += delta_diff * delta_diff;
+		using_stations_count++;
+	}
+
+	if (using_stations_count < 3){
+		return NULL_VALUE;
+	}
+	return sqrt(diff_function_value) / using_stations_count;
+}
+
+
+float get_ray_parameter_table_time(global const float *ray_offsets,
+								   global const float *ray_times,
+								   int ray_parameters_count,
+								   int altitude_row, float offset){
+	// offsets of the row grow with ray parameter, so the sample interval
+	// is found by binary search
+	global const float *row_offsets = ray_offsets + altitude_row * ray_parameters_count;
+	global const float *row_times = ray_times + altitude_row * ray_parameters_count;
+	if ((row_offsets[0] == NULL_VALUE) || (offset > row_offsets[ray_parameters_count - 1])){
+		return NULL_VALUE;
+	}
+
+	int low_index = 0;
+	int high_index = ray_parameters_count - 1;
+	while (high_index - low_index > 1){
+		int middle_index = (low_index + high_index) / 2;
+		if (row_offsets[middle_index] <= offset){
+			low_index = middle_index;
+		}
+		else{
+			high_index = middle_index;
+		}
+	}
+
+	// rows of sources at the stations altitude have only zero offsets
+	float interval = row_offsets[high_index] - row_offsets[low_index];
+	if (interval == 0){
+		return row_times[low_index];
+	}
+	float weight = (offset - row_offsets[low_index]) / interval;
+	return row_times[low_index] + (row_times[high_index] - row_times[low_index]) * weight;
+}
+
+
+float get_ray_parameter_time(global const float *ray_offsets,
+							 global const float *ray_times,
+							 int ray_parameters_count, int altitude_row,
+							 constant float *model, int layers_count,
+							 float source_altitude, float stations_altitude,
+							 float offset, float accuracy, int frequency){
+	// offsets beyond the last sampled ray parameter (near grazing
+	// incidence) are solved by rays like without tables
+	float time = get_ray_parameter_table_time(
+		ray_offsets, ray_times, ray_parameters_count, altitude_row, offset
+	);
+	if (time != NULL_VALUE){
+		return time;
+	}
+	return get_ray_float_time(model, layers_count, 0, source_altitude,
+		offset, stations_altitude, accuracy, frequency);
+}
+
+
+float get_ray_parameter_diff_function(global const float *ray_offsets,
+	global const float *ray_times, int ray_parameters_count,
+	int altitude_row, constant float *model, int layers_count,
+	global const int *real_delays, int stations_count, int event_id,
+	global const float *station_coordinates, float stations_altitude,
+	float3 node_coordinate, float accuracy, int frequency,
+	int base_station_index
+){
+	float2 base_coordinate = {
+		station_coordinates[base_station_index * COORDINATE_COLUMNS_COUNT],
+		station_coordinates[base_station_index * COORDINATE_COLUMNS_COUNT + 1]
+	};
+
+	float offset = sqrt(
+		pown(base_coordinate.s0 - node_coordinate.s0, 2) +
+		pown(base_coordinate.s1 - node_coordinate.s1, 2)
+	);
+
+	float base_table_time = get_ray_parameter_time(
+		ray_offsets, ray_times, ray_parameters_count, altitude_row, model,
+		layers_count, node_coordinate.s2, stations_altitude, offset,
+		accuracy, frequency
+	);
+	if (base_table_time == NULL_VALUE){
+		return NULL_VALUE;
+	}
+	int base_time = (int)base_table_time;
+
+	float diff_function_value = 0;
+	int using_stations_count = 0;
+	for (int i=0; i < stations_count; i++){
+		float2 coordinate = {
+			station_coordinates[i * COORDINATE_COLUMNS_COUNT],
+			station_coordinates[i * COORDINATE_COLUMNS_COUNT + 1]
+		};
+
+		offset = sqrt(
+			pown(coordinate.s0 - node_coordinate.s0, 2) +
+			pown(coordinate.s1 - node_coordinate.s1, 2)
+		);
+
+		float table_time = get_ray_parameter_time(
+			ray_offsets, ray_times, ray_parameters_count, altitude_row,
+			model, layers_count, node_coordinate.s2, stations_altitude,
+			offset, accuracy, frequency
+		);
+		if (table_time == NULL_VALUE){
+			continue;
+		}
+
+		int theor_time_diff = (int)table_time - base_time;
+
+		if (theor_time_diff < 0){
+			continue;
+		}
+
+		int real_time_diff = real_delays[event_id * stations_count + i];
+		int delta_diff = theor_time_diff - real_time_diff;
+		diff_function_value += delta_diff * delta_diff;
+		using_stations_count++;
+	}
+
+	if (using_stations_count < 3){
+		return NULL_VALUE;
+	}
+	return sqrt(diff_function_value) / using_stations_count;
+}
+
+
+float get_lattice_diff_function(global const int *lattice_times,
+	int lattice_node_id, global const int *real_delays, int stations_count,
+	int event_id, int base_station_index
+){
+	global const int *node_times = lattice_times + lattice_node_id * stations_count;
+
+	int base_time = node_times[base_station_index];
+	if (base_time == NULL_VALUE){
+		return NULL_VALUE;
+	}
+
+	float diff_function_value = 0;
+	int using_stations_count = 0;
+	for (int i=0; i < stations_count; i++){
+		int time = node_times[i];
+		if (time == NULL_VALUE){
+			continue;
+		}
+
+		int theor_time_diff = time - base_time;
+
+		if (theor_time_diff < 0){
+			continue;
+		}
+
+		int real_time_diff = real_delays[event_id * stations_count + i];
+		int delta_diff = theor_time_diff - real_time_diff;
+		diff_function_value += delta_diff * delta_diff;
+		using_stations_count++;
+	}
+
+	if (using_stations_count < 3){
+		return NULL_VALUE;
+	}
+	return sqrt(diff_function_value) / using_stations_count;
+}
+
+
+float3 get_node_coordinate(global const float *search_origins, int event_id,
+						   int node_id, float dx, float dy, float dz,
+						   int nx, int ny){
+	float3 node_coordinate = {
+		((node_id % (nx * ny)) % nx) * dx + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT],
+		((node_id % (nx * ny)) / nx) * dy + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 1],
+		(node_id / (nx * ny)) * dz + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 2]
+	};
+	return node_coordinate;
+}
+
+
+kernel void get_diff_function_cube(constant float *model,
+	int layers_count, global const int *real_delays, int stations_count, int
+	events_count, global const float *station_coordinates,
+	float stations_altitude,
+	global const float *search_origins,
+	float dx, float dy, float dz,
+	int nx, int ny, int nz, float accuracy, int frequency,
+	int base_station_index, global float *diff_func_cube_values
+){
+	int global_id = get_global_thread_id();
+	int all_nodes_count = nx * ny * nz;
+	if (global_id > all_nodes_count * events_count - 1){
+		return;
+	}
+
+	int event_id = global_id / (nx * ny * nz);
+	int node_id = global_id % (nx * ny * nz);
+
+	int3 node_index = {
+		(node_id % (nx * ny)) % nx,
+		(node_id % (nx * ny)) / nx,
+		node_id / (nx * ny)
+	};
+
+	float3 node_coordinate = {
+		node_index.s0 * dx + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT],
+		node_index.s1 * dy + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 1],
+		node_index.s2 * dz + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 2]
+	};
+
+	float min_model_altitude = model[(layers_count - 1) * MODEL_COLUMNS_COUNT];
+	float max_model_altitude = model[1];
+
+
+	if (node_coordinate.s2 < min_model_altitude){
+		diff_func_cube_values[global_id] = NULL_VALUE;
+	}
+	else if (node_coordinate.s2 > max_model_altitude){
+		diff_func_cube_values[global_id] = NULL_VALUE;
+	}
+	else{
+		diff_func_cube_values[global_id] = get_diff_function(
+			model, layers_count, real_delays, stations_count, events_count,
+			event_id, station_coordinates, stations_altitude, node_coordinate,
+			accuracy, frequency, base_station_index
+		);
+	}
+}
+
+
+kernel void get_pruned_diff_function_cube(constant float *model,
+	int layers_count, global const int *real_delays, int stations_count, int
+	events_count, global const float *station_coordinates,
+	float stations_altitude,
+	global const float *search_origins,
+	float dx, float dy, float dz,
+	int nx, int ny, int nz, float accuracy, int frequency,
+	int base_station_index, volatile global int *best_values,
+	global float *diff_func_cube_values
+){
+	// values of abandoned nodes are their lower bounds, which exceed the
+	// minimum of the event
+	int global_id = get_global_thread_id();
+	int all_nodes_count = nx * ny * nz;
+	if (global_id > all_nodes_count * events_count - 1){
+		return;
+	}
+
+	int event_id = global_id / (nx * ny * nz);
+	int node_id = global_id % (nx * ny * nz);
+	float3 node_coordinate = get_node_coordinate(
+		search_origins, event_id, node_id, dx, dy, dz, nx, ny
+	);
+
+	float min_model_altitude = model[(layers_count - 1) * MODEL_COLUMNS_COUNT];
+	float max_model_altitude = model[1];
+
+
+	if (node_coordinate.s2 < min_model_altitude){
+		diff_func_cube_values[global_id] = NULL_VALUE;
+	}
+	else if (node_coordinate.s2 > max_model_altitude){
+		diff_func_cube_values[global_id] = NULL_VALUE;
+	}
+	else{
+		diff_func_cube_values[global_id] = get_pruned_diff_function(
+			model, layers_count, real_delays, stations_count, event_id,
+			station_coordinates, stations_altitude, node_coordinate,
+			accuracy, frequency, base_station_index, best_values
+		);
+	}
+}
+
+
+kernel void get_diff_function_columns(constant float *model,
+	int layers_count, global const int *real_delays, int stations_count, int
+	events_count, global const float *station_coordinates,
+	float stations_altitude,
+	global const float *search_origins,
+	float dx, float dy, float dz,
+	int nx, int ny, int nz, float accuracy, int frequency,
+	int base_station_index, local float *columns_offsets,
+	global float *diff_func_cube_values
+){
+	// work-group owns columns of nodes with the same (ix, iy), the first
+	// dimension goes along depths, the second one along columns and the
+	// third one along events
+	int depth_id = get_local_id(0);
+	int depths_step = get_local_size(0);
+	int column_id = get_global_id(1);
+	int event_id = get_global_id(2);
+	bool is_column = column_id < nx * ny;
+	local float *offsets = columns_offsets + get_local_id(1) * stations_count;
+
+	float2 column_coordinate = {
+		(column_id % nx) * dx + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT],
+		(column_id / nx) * dy + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 1]
+	};
+	for (int i = depth_id; is_column && (i < stations_count); i += depths_step){
+		offsets[i] = sqrt(
+			pown(station_coordinates[i * COORDINATE_COLUMNS_COUNT] - column_coordinate.s0, 2) +
+			pown(station_coordinates[i * COORDINATE_COLUMNS_COUNT + 1] - column_coordinate.s1, 2)
+		);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+	if (!is_column){
+		return;
+	}
+
+	float min_model_altitude = model[(layers_count - 1) * MODEL_COLUMNS_COUNT];
+	float max_model_altitude = model[1];
+	for (int iz = depth_id; iz < nz; iz += depths_step){
+		float node_altitude = iz * dz + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 2];
+		int global_id = (event_id * nz + iz) * nx * ny + column_id;
+
+		if ((node_altitude < min_model_altitude) || (node_altitude > max_model_altitude)){
+			diff_func_cube_values[global_id] = NULL_VALUE;
+		}
+		else{
+			diff_func_cube_values[global_id] = get_column_diff_function(
+				model, layers_count, real_delays, stations_count, event_id,
+				offsets, stations_altitude, node_altitude, accuracy,
+				frequency, base_station_index
+			);
+		}
+	}
+}
+
+
+kernel void get_travel_times_table(constant float *model,
+	int layers_count, float stations_altitude,
+	float min_altitude, float altitude_step, int altitudes_count,
+	float offset_step, int offsets_count, float accuracy, int frequency,
+	global float *travel_times
+){
+	int global_id = get_global_thread_id();
+	if (global_id > altitudes_count * offsets_count - 1){
+		return;
+	}
+
+	float source_altitude = min_altitude + (global_id / offsets_count) * altitude_step;
+	float offset = (global_id % offsets_count) * offset_step;
+
+	int layer_index = get_model_layer_index_by_altitude(model, layers_count, source_altitude);
+	if (layer_index == NULL_VALUE){
+		travel_times[global_id] = NULL_VALUE;
+		return;
+	}
+
+	travel_times[global_id] = get_ray_float_time(
+		model, layers_count, 0, source_altitude, offset, stations_altitude,
+		accuracy, frequency
+	);
+}
+
+
+kernel void get_table_diff_function_cube(global const float *travel_times,
+	float min_altitude, float altitude_step, int altitudes_count,
+	float offset_step, int offsets_count,
+	constant float *model, int layers_count,
+	global const int *real_delays, int stations_count, int events_count,
+	global const float *station_coordinates,
+	global const float *search_origins,
+	float dx, float dy, float dz,
+	int nx, int ny, int nz,
+	int base_station_index, global float *diff_func_cube_values
+){
+	int global_id = get_global_thread_id();
+	int all_nodes_count = nx * ny * nz;
+	if (global_id > all_nodes_count * events_count - 1){
+		return;
+	}
+
+	int event_id = global_id / (nx * ny * nz);
+	int node_id = global_id % (nx * ny * nz);
+
+	int3 node_index = {
+		(node_id % (nx * ny)) % nx,
+		(node_id % (nx * ny)) / nx,
+		node_id / (nx * ny)
+	};
+
+	float3 node_coordinate = {
+		node_index.s0 * dx + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT],
+		node_index.s1 * dy + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 1],
+		node_index.s2 * dz + search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 2]
+	};
+
+	float min_model_altitude = model[(layers_count - 1) * MODEL_COLUMNS_COUNT];
+	float max_model_altitude = model[1];
+
+
+	if (node_coordinate.s2 < min_model_altitude){
+		diff_func_cube_values[global_id] = NULL_VALUE;
+	}
+	else if (node_coordinate.s2 > max_model_altitude){
+		diff_func_cube_values[global_id] = NULL_VALUE;
+	}
+	else{
+		diff_func_cube_values[global_id] = get_table_diff_function(
+			travel_times, min_altitude, altitude_step, altitudes_count,
+			offset_step, offsets_count, real_delays, stations_count,
+			event_id, station_coordinates, node_coordinate,
+			base_station_index
+		);
+	}
+}
+
+
+kernel void get_ray_parameter_tables(constant float *model,
+	int layers_count, float stations_altitude,
+	global const float *source_altitudes, int altitudes_count,
+	int ray_parameters_count, int frequency,
+	global float *ray_offsets, global float *ray_times
+){
+	// X(p) and T(p) rows of every source altitude, incidence angle in the
+	// fastest layer is sampled uniformly below 90 degrees, so offsets of
+	// rays near grazing incidence are out of the rows
+	int global_id = get_global_thread_id();
+	if (global_id > altitudes_count * ray_parameters_count - 1){
+		return;
+	}
+
+	float source_altitude = source_altitudes[global_id / ray_parameters_count];
+	float lower_altitude = fmin(source_altitude, stations_altitude);
+	float upper_altitude = fmax(source_altitude, stations_altitude);
+	int lower_layer_index = get_model_layer_index_by_altitude(model, layers_count, lower_altitude);
+	int upper_layer_index = get_model_layer_index_by_altitude(model, layers_count, upper_altitude);
+	if ((lower_layer_index == NULL_VALUE) || (upper_layer_index == NULL_VALUE)){
+		ray_offsets[global_id] = NULL_VALUE;
+		ray_times[global_id] = NULL_VALUE;
+		return;
+	}
+
+	ray_float max_angle_part = (ray_float)(global_id % ray_parameters_count) / ray_parameters_count;
+	ray_float ray_parameter = sin(max_angle_part * RAY_PI_2) / get_max_layers_vp(
+		model, lower_layer_index, upper_layer_index
+	);
+	float3 trace = get_ray_parameter_trace(
+		model, lower_layer_index, upper_layer_index, lower_altitude,
+		upper_altitude, ray_parameter, frequency
+	);
+	ray_offsets[global_id] = trace.s0;
+	ray_times[global_id] = trace.s1;
+}
+
+
+kernel void get_ray_parameter_diff_function_cube(
+	global const float *ray_offsets, global const float *ray_times,
+	int ray_parameters_count, global const int *altitude_rows,
+	constant float *model, int layers_count,
+	global const int *real_delays, int stations_count, int events_count,
+	global const float *station_coordinates, float stations_altitude,
+	global const float *search_origins,
+	float dx, float dy, float dz,
+	int nx, int ny, int nz,
+	float accuracy, int frequency,
+	int base_station_index, global float *diff_func_cube_values
+){
+	int global_id = get_global_thread_id();
+	int all_nodes_count = nx * ny * nz;
+	if (global_id > all_nodes_count * events_count - 1){
+		return;
+	}
+
+	int event_id = global_id / (nx * ny * nz);
+	int node_id = global_id % (nx * ny * nz);
+	float3 node_coordinate = get_node_coordinate(
+		search_origins, event_id, node_id, dx, dy, dz, nx, ny
+	);
+
+	float min_model_altitude = model[(layers_count - 1) * MODEL_COLUMNS_COUNT];
+	float max_model_altitude = model[1];
+
+
+	if (node_coordinate.s2 < min_model_altitude){
+		diff_func_cube_values[global_id] = NULL_VALUE;
+	}
+	else if (node_coordinate.s2 > max_model_altitude){
+		diff_func_cube_values[global_id] = NULL_VALUE;
+	}
+	else{
+		diff_func_cube_values[global_id] = get_ray_parameter_diff_function(
+			ray_offsets, ray_times, ray_parameters_count,
+			altitude_rows[event_id * nz + node_id / (nx * ny)], model,
+			layers_count, real_delays, stations_count, event_id,
+			station_coordinates, stations_altitude, node_coordinate,
+			accuracy, frequency, base_station_index
+		);
+	}
+}
+
+
+kernel void get_lattice_travel_times(constant float *model,
+	int layers_count, global const float *station_coordinates,
+	int stations_count, float stations_altitude,
+	float lattice_x, float lattice_y, float lattice_altitude,
+	float dx, float dy, float dz,
+	int lattice_nx, int lattice_ny, int lattice_nz,
+	float accuracy, int frequency, global int *lattice_times
+){
+	int global_id = get_global_thread_id();
+	if (global_id > lattice_nx * lattice_ny * lattice_nz * stations_count - 1){
+		return;
+	}
+
+	int node_id = global_id / stations_count;
+	int station_id = global_id % stations_count;
+
+	float3 node_coordinate = {
+		((node_id % (lattice_nx * lattice_ny)) % lattice_nx) * dx + lattice_x,
+		((node_id % (lattice_nx * lattice_ny)) / lattice_nx) * dy + lattice_y,
+		(node_id / (lattice_nx * lattice_ny)) * dz + lattice_altitude
+	};
+
+	float min_model_altitude = model[(layers_count - 1) * MODEL_COLUMNS_COUNT];
+	float max_model_altitude = model[1];
+	if ((node_coordinate.s2 < min_model_altitude) || (node_coordinate.s2 > max_model_altitude)){
+		lattice_times[global_id] = NULL_VALUE;
+		return;
+	}
+
+	float offset = sqrt(
+		pown(station_coordinates[station_id * COORDINATE_COLUMNS_COUNT] - node_coordinate.s0, 2) +
+		pown(station_coordinates[station_id * COORDINATE_COLUMNS_COUNT + 1] - node_coordinate.s1, 2)
+	);
+
+	lattice_times[global_id] = get_ray_time(
+		model, layers_count, 0, node_coordinate.s2, offset, stations_altitude,
+		accuracy, frequency
+	);
+}
+
+
+int get_lattice_node_id(global const int *lattice_offsets, int lattice_nx,
+						int lattice_ny, int event_id, int node_id, int nx,
+						int ny){
+	int3 lattice_index = {
+		(node_id % (nx * ny)) % nx + lattice_offsets[event_id * SEARCH_ORIGINS_COLUMNS_COUNT],
+		(node_id % (nx * ny)) / nx + lattice_offsets[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 1],
+		node_id / (nx * ny) + lattice_offsets[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 2]
+	};
+	return (lattice_index.s2 * lattice_ny + lattice_index.s1) * lattice_nx + lattice_index.s0;
+}
+
+
+kernel void get_lattice_diff_function_cube(global const int *lattice_times,
+	int lattice_nx, int lattice_ny, global const int *lattice_offsets,
+	global const int *real_delays, int stations_count, int events_count,
+	int nx, int ny, int nz,
+	int base_station_index, global float *diff_func_cube_values
+){
+	int global_id = get_global_thread_id();
+	int all_nodes_count = nx * ny * nz;
+	if (global_id > all_nodes_count * events_count - 1){
+		return;
+	}
+
+	int event_id = global_id / (nx * ny * nz);
+	int node_id = global_id % (nx * ny * nz);
+	int lattice_node_id = get_lattice_node_id(
+		lattice_offsets, lattice_nx, lattice_ny, event_id, node_id, nx, ny
+	);
+
+	diff_func_cube_values[global_id] = get_lattice_diff_function(
+		lattice_times, lattice_node_id, real_delays, stations_count,
+		event_id, base_station_index
+	);
+}
+
+
+int3 get_lattice_index(int lattice_node_id, int lattice_nx, int lattice_ny){
+	int3 lattice_index = {
+		lattice_node_id % lattice_nx,
+		(lattice_node_id / lattice_nx) % lattice_ny,
+		lattice_node_id / (lattice_nx * lattice_ny)
+	};
+	return lattice_index;
+}
+
+
+bool is_cube_intersected(global const int *lattice_offsets, int event_id,
+						 int3 min_index, int3 max_index, int nx, int ny,
+						 int nz){
+	// cube of the event and the box of lattice indexes have common nodes
+	global const int *offsets = lattice_offsets + event_id * SEARCH_ORIGINS_COLUMNS_COUNT;
+	return (min_index.s0 < offsets[0] + nx) && (max_index.s0 >= offsets[0]) &&
+		(min_index.s1 < offsets[1] + ny) && (max_index.s1 >= offsets[1]) &&
+		(min_index.s2 < offsets[2] + nz) && (max_index.s2 >= offsets[2]);
+}
+
+
+kernel void get_lattice_misfits(global const int *lattice_times,
+	int lattice_nx, int lattice_ny, int lattice_nz,
+	global const int *lattice_offsets, global const int *real_delays,
+	int stations_count, int events_count, int nx, int ny, int nz,
+	int base_station_index, int tile_size,
+	local int *nodes_tile, local int *events_tile,
+	global float *diff_func_cube_values
+){
+	// Misfits are evaluated by tiles of lattice nodes against blocks of
+	// events. A work-group stages times of its nodes in local memory by
+	// rows and evaluates them against every block of events whose cubes
+	// intersect the tile; rows of all stations are loaded once for all
+	// the blocks. Every node keeps misfits of the block events and writes
+	// the ones whose cube holds it. Rows are padded by one, so reading the
+	// own row of every work-item is free of bank conflicts. NULL_VALUE on
+	// either side masks a station.
+	int group_size = get_local_size(0);
+	int local_id = get_local_id(0);
+	int first_node_id = get_group_id(0) * group_size;
+	int last_node_id = min(first_node_id + group_size, lattice_nx * lattice_ny * lattice_nz) - 1;
+	int lattice_node_id = min(first_node_id + local_id, last_node_id);
+	int row_size = tile_size + 1;
+
+	// bounding box of the tile, the same for the whole work-group
+	int3 lattice_index = get_lattice_index(lattice_node_id, lattice_nx, lattice_ny);
+	int3 min_index = get_lattice_index(first_node_id, lattice_nx, lattice_ny);
+	int3 max_index = get_lattice_index(last_node_id, lattice_nx, lattice_ny);
+	if (min_index.s2 != max_index.s2){
+		min_index.s1 = 0;
+		max_index.s1 = lattice_ny - 1;
+	}
+	if ((min_index.s2 != max_index.s2) || (min_index.s1 != max_index.s1)){
+		min_index.s0 = 0;
+		max_index.s0 = lattice_nx - 1;
+	}
+
+	int base_time = lattice_times[lattice_node_id * stations_count + base_station_index];
+	bool is_tile_loaded = false;
+	for (int first_event_id = 0; first_event_id < events_count; first_event_id += MISFITS_EVENTS_COUNT){
+		int block_events_count = min(MISFITS_EVENTS_COUNT, events_count - first_event_id);
+		bool is_block_intersected = false;
+		for (int k = 0; k < block_events_count; k++){
+			is_block_intersected |= is_cube_intersected(
+				lattice_offsets, first_event_id + k, min_index, max_index,
+				nx, ny, nz
+			);
+		}
+		if (!is_block_intersected){
+			continue;
+		}
+
+		float diff_function_values[MISFITS_EVENTS_COUNT];
+		int using_stations_counts[MISFITS_EVENTS_COUNT];
+		for (int k = 0; k < MISFITS_EVENTS_COUNT; k++){
+			diff_function_values[k] = 0;
+			using_stations_counts[k] = 0;
+		}
+
+		for (int first_station_id = 0; first_station_id < stations_count; first_station_id += tile_size){
+			if (!is_tile_loaded){
+				for (int i = local_id; i < group_size * tile_size; i += group_size){
+					int tile_node_id = min(first_node_id + i / tile_size, last_node_id);
+					int station_id = first_station_id + i % tile_size;
+					int time = NULL_VALUE;
+					if (station_id < stations_count){
+						time = lattice_times[tile_node_id * stations_count + station_id];
+					}
+					nodes_tile[(i / tile_size) * row_size + i % tile_size] = time;
+				}
+			}
+			for (int i = local_id; i < MISFITS_EVENTS_COUNT * tile_size; i += group_size){
+				int event_id = first_event_id + i / tile_size;
+				int station_id = first_station_id + i % tile_size;
+				if ((event_id < events_count) && (station_id < stations_count)){
+					events_tile[i] = real_delays[event_id * stations_count + station_id];
+				}
+				else{
+					events_tile[i] = NULL_VALUE;
+				}
+			}
+			barrier(CLK_LOCAL_MEM_FENCE);
+
+			for (int i = 0; i < tile_size; i++){
+				int time = nodes_tile[local_id * row_size + i];
+				int is_node_valid = (base_time != NULL_VALUE) && (time != NULL_VALUE) && (time >= base_time);
+				for (int k = 0; k < MISFITS_EVENTS_COUNT; k++){
+					int real_time_diff = events_tile[k * tile_size + i];
+					int is_valid = is_node_valid && (real_time_diff != NULL_VALUE);
+					float delta_diff = is_valid * (time - base_time - real_time_diff);
+					diff_function_values[k] += delta_diff * delta_diff;
+					using_stations_counts[k] += is_valid;
+				}
+			}
+			barrier(CLK_LOCAL_MEM_FENCE);
+		}
+		is_tile_loaded = tile_size >= stations_count;
+
+		if (first_node_id + local_id > last_node_id){
+			continue;
+		}
+		for (int k = 0; k < block_events_count; k++){
+			int event_id = first_event_id + k;
+			global const int *offsets = lattice_offsets + event_id * SEARCH_ORIGINS_COLUMNS_COUNT;
+			int3 cube_index = {
+				lattice_index.s0 - offsets[0],
+				lattice_index.s1 - offsets[1],
+				lattice_index.s2 - offsets[2]
+			};
+			if ((cube_index.s0 < 0) || (cube_index.s0 >= nx) ||
+				(cube_index.s1 < 0) || (cube_index.s1 >= ny) ||
+				(cube_index.s2 < 0) || (cube_index.s2 >= nz)){
+				continue;
+			}
+
+			int node_id = (cube_index.s2 * ny + cube_index.s1) * nx + cube_index.s0;
+			float diff_function_value = NULL_VALUE;
+			if (using_stations_counts[k] >= 3){
+				diff_function_value = sqrt(diff_function_values[k]) / using_stations_counts[k];
+			}
+			diff_func_cube_values[event_id * nx * ny * nz + node_id] = diff_function_value;
+		}
+	}
+}
+
+
+void reduce_local_minimum(local float *group_values, local int *group_nodes){
+	// tree reduction over power of two work-group, equal values are
+	// resolved to the lower node like in the serial scan
+	int local_id = get_local_id(0);
+	for (int step = get_local_size(0) / 2; step > 0; step /= 2){
+		barrier(CLK_LOCAL_MEM_FENCE);
+		if (local_id < step){
+			float other_value = group_values[local_id + step];
+			int other_node = group_nodes[local_id + step];
+			if ((other_value < group_values[local_id]) ||
+				((other_value == group_values[local_id]) && (other_node < group_nodes[local_id]))){
+				group_values[local_id] = other_value;
+				group_nodes[local_id] = other_node;
+			}
+		}
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+
+void store_partial_minimum(float min_diff_function, int minimal_node,
+						   int events_count,
+						   local float *group_values,
+						   local int *group_nodes,
+						   global float *partial_values,
+						   global int *partial_nodes){
+	// minimum of the work-group is stored as partial of the event, the
+	// event of work-item is the second NDRange dimension
+	int local_id = get_local_id(0);
+	int event_id = get_global_id(1);
+	int groups_count = get_num_groups(0);
+
+	group_values[local_id] = min_diff_function;
+	group_nodes[local_id] = minimal_node;
+	reduce_local_minimum(group_values, group_nodes);
+
+	if ((local_id == 0) && (event_id < events_count)){
+		partial_values[event_id * groups_count + get_group_id(0)] = group_values[0];
+		partial_nodes[event_id * groups_count + get_group_id(0)] = group_nodes[0];
+	}
+}
+
+
+kernel void reduce_minimal_nodes(global const float *diff_func_values,
+								 int nodes_count, int events_count,
+								 local float *group_values,
+								 local int *group_nodes,
+								 global float *partial_values,
+								 global int *partial_nodes){
+	int event_id = get_global_id(1);
+
+	float min_diff_function = INFINITY;
+	int minimal_node = NULL_VALUE;
+	if (event_id < events_count){
+		global const float *event_values = diff_func_values + event_id * nodes_count;
+		for (int i = get_global_id(0); i < nodes_count; i += get_global_size(0)){
+			float diff_func_value = event_values[i];
+			if ((diff_func_value != NULL_VALUE) && (diff_func_value < min_diff_function)){
+				min_diff_function = diff_func_value;
+				minimal_node = i;
+			}
+		}
+	}
+
+	store_partial_minimum(min_diff_function, minimal_node, events_count,
+						  group_values, group_nodes,
+						  partial_values, partial_nodes);
+}
+
+
+kernel void get_diff_function_minimal_nodes(constant float *model,
+	int layers_count, global const int *real_delays, int stations_count, int
+	events_count, global const float *station_coordinates,
+	float stations_altitude,
+	global const float *search_origins,
+	float dx, float dy, float dz,
+	int nx, int ny, int nz, float accuracy, int frequency,
+	int base_station_index,
+	local float *group_values, local int *group_nodes,
+	global float *partial_values, global int *partial_nodes
+){
+	// get_diff_function_cube fused with the first reduction stage, the
+	// cube values are never stored
+	int event_id = get_global_id(1);
+	float min_model_altitude = model[(layers_count - 1) * MODEL_COLUMNS_COUNT];
+	float max_model_altitude = model[1];
+
+	float min_diff_function = INFINITY;
+	int minimal_node = NULL_VALUE;
+	if (event_id < events_count){
+		for (int node_id = get_global_id(0); node_id < nx * ny * nz; node_id += get_global_size(0)){
+			float3 node_coordinate = get_node_coordinate(
+				search_origins, event_id, node_id, dx, dy, dz, nx, ny
+			);
+			if ((node_coordinate.s2 < min_model_altitude) || (node_coordinate.s2 > max_model_altitude)){
+				continue;
+			}
+
+			float diff_func_value = get_diff_function(
+				model, layers_count, real_delays, stations_count, events_count,
+				event_id, station_coordinates, stations_altitude, node_coordinate,
+				accuracy, frequency, base_station_index
+			);
+			if ((diff_func_value != NULL_VALUE) && (diff_func_value < min_diff_function)){
+				min_diff_function = diff_func_value;
+				minimal_node = node_id;
+			}
+		}
+	}
+
+	store_partial_minimum(min_diff_function, minimal_node, events_count,
+						  group_values, group_nodes,
+						  partial_values, partial_nodes);
+}
+
+
+kernel void get_table_diff_function_minimal_nodes(global const float *travel_times,
+	float min_altitude, float altitude_step, int altitudes_count,
+	float offset_step, int offsets_count,
+	constant float *model, int layers_count,
+	global const int *real_delays, int stations_count, int events_count,
+	global const float *station_coordinates,
+	global const float *search_origins,
+	float dx, float dy, float dz,
+	int nx, int ny, int nz,
+	int base_station_index,
+	local float *group_values, local int *group_nodes,
+	global float *partial_values, global int *partial_nodes
+){
+	// get_table_diff_function_cube fused with the first reduction stage
+	int event_id = get_global_id(1);
+	float min_model_altitude = model[(layers_count - 1) * MODEL_COLUMNS_COUNT];
+	float max_model_altitude = model[1];
+
+	float min_diff_function = INFINITY;
+	int minimal_node = NULL_VALUE;
+	if (event_id < events_count){
+		for (int node_id = get_global_id(0); node_id < nx * ny * nz; node_id += get_global_size(0)){
+			float3 node_coordinate = get_node_coordinate(
+				search_origins, event_id, node_id, dx, dy, dz, nx, ny
+			);
+			if ((node_coordinate.s2 < min_model_altitude) || (node_coordinate.s2 > max_model_altitude)){
+				continue;
+			}
+
+			float diff_func_value = get_table_diff_function(
+				travel_times, min_altitude, altitude_step, altitudes_count,
+				offset_step, offsets_count, real_delays, stations_count,
+				event_id, station_coordinates, node_coordinate,
+				base_station_index
+			);
+			if ((diff_func_value != NULL_VALUE) && (diff_func_value < min_diff_function)){
+				min_diff_function = diff_func_value;
+				minimal_node = node_id;
+			}
+		}
+	}
+
+	store_partial_minimum(min_diff_function, minimal_node, events_count,
+						  group_values, group_nodes,
+						  partial_values, partial_nodes);
+}
+
+
+kernel void merge_minimal_nodes(global const float *partial_values,
+								global const int *partial_nodes,
+								int partials_count, int events_count,
+								local float *group_values,
+								local int *group_nodes,
+								global int *minimal_nodes,
+								global float *error){
+	int local_id = get_local_id(0);
+	int group_size = get_local_size(0);
+	int event_id = get_global_id(1);
+
+	float min_diff_function = INFINITY;
+	int minimal_node = NULL_VALUE;
+	if (event_id < events_count){
+		for (int i = local_id; i < partials_count; i += group_size){
+			float diff_func_value = partial_values[event_id * partials_count + i];
+			int node = partial_nodes[event_id * partials_count + i];
+			if ((diff_func_value < min_diff_function) ||
+				((diff_func_value == min_diff_function) && (node < minimal_node))){
+				min_diff_function = diff_func_value;
+				minimal_node = node;
+			}
+		}
+	}
+
+	group_values[local_id] = min_diff_function;
+	group_nodes[local_id] = minimal_node;
+	reduce_local_minimum(group_values, group_nodes);
+
+	if ((local_id == 0) && (event_id < events_count)){
+		minimal_nodes[event_id] = group_nodes[0];
+		error[event_id] = group_values[0];
+	}
+}
+
+
+int is_next_best_node(float value, int node,
+					  float last_value, int last_node,
+					  float best_value, int best_node){
+	// nodes are ordered by value, then by node like in the serial scan,
+	// the next best node follows the last selected one in this order
+	int is_after_last = (value > last_value) || ((value == last_value) && (node > last_node));
+	int is_before_best = (value < best_value) || ((value == best_value) && (node < best_node));
+	return is_after_last && is_before_best;
+}
+
+
+kernel void reduce_best_nodes(global const float *diff_func_values,
+							  int nodes_count, int events_count,
+							  int best_nodes_count,
+							  local float *group_values,
+							  local int *group_nodes,
+							  global float *partial_values,
+							  global int *partial_nodes){
+	// every power of two work-group selects the best nodes of its part of
+	// the event (the second NDRange dimension) one by one, each round is
+	// a work-group minimum over nodes following the last selected one
+	int local_id = get_local_id(0);
+	int event_id = get_global_id(1);
+	int partial_id = (event_id * get_num_groups(0) + get_group_id(0)) * best_nodes_count;
+
+	float last_value = -INFINITY;
+	int last_node = NULL_VALUE;
+	for (int k = 0; k < best_nodes_count; k++){
+		float best_value = INFINITY;
+		int best_node = NULL_VALUE;
+		if (event_id < events_count){
+			global const float *event_values = diff_func_values + event_id * nodes_count;
+			for (int i = get_global_id(0); i < nodes_count; i += get_global_size(0)){
+				float diff_func_value = event_values[i];
+				if ((diff_func_value != NULL_VALUE) &&
+					is_next_best_node(diff_func_value, i, last_value, last_node, best_value, best_node)){
+					best_value = diff_func_value;
+					best_node = i;
+				}
+			}
+		}
+
+		group_values[local_id] = best_value;
+		group_nodes[local_id] = best_node;
+		reduce_local_minimum(group_values, group_nodes);
+		last_value = group_values[0];
+		last_node = group_nodes[0];
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		if ((local_id == 0) && (event_id < events_count)){
+			partial_values[partial_id + k] = last_value;
+			partial_nodes[partial_id + k] = last_node;
+		}
+	}
+}
+
+
+kernel void merge_best_nodes(global const float *partial_values,
+							 global const int *partial_nodes,
+							 int partials_count, int events_count,
+							 int best_nodes_count,
+							 local float *group_values,
+							 local int *group_nodes,
+							 global int *best_nodes){
+	// one power of two work-group per event selects the best nodes among
+	// the best nodes of all parts, missing nodes are NULL
+	int local_id = get_local_id(0);
+	int group_size = get_local_size(0);
+	int event_id = get_global_id(1);
+
+	float last_value = -INFINITY;
+	int last_node = NULL_VALUE;
+	for (int k = 0; k < best_nodes_count; k++){
+		float best_value = INFINITY;
+		int best_node = NULL_VALUE;
+		if (event_id < events_count){
+			for (int i = local_id; i < partials_count; i += group_size){
+				float diff_func_value = partial_values[event_id * partials_count + i];
+				int node = partial_nodes[event_id * partials_count + i];
+				if ((node != NULL_VALUE) &&
+					is_next_best_node(diff_func_value, node, last_value, last_node, best_value, best_node)){
+					best_value = diff_func_value;
+					best_node = node;
+				}
+			}
+		}
+
+		group_values[local_id] = best_value;
+		group_nodes[local_id] = best_node;
+		reduce_local_minimum(group_values, group_nodes);
+		last_value = group_values[0];
+		last_node = group_nodes[0];
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		if ((local_id == 0) && (event_id < events_count)){
+			best_nodes[event_id * best_nodes_count + k] = last_node;
+		}
+	}
+}
+
+
+kernel void get_best_nodes_values(global const float *diff_func_values,
+									int nodes_count, int events_count,
+									int best_nodes_count,
+									global const int *best_nodes,
+									global float *best_values){
+	int global_id = get_global_thread_id();
+
+	if (global_id > events_count * best_nodes_count - 1){
+		return;
+	}
+
+	int event_id = global_id / best_nodes_count;
+	int node_id = best_nodes[global_id];
+	if (node_id == NULL_VALUE){
+		best_values[global_id] = NULL_VALUE;
+	}
+	else{
+		best_values[global_id] = diff_func_values[event_id * nodes_count + node_id];
+	}
+}
+
+
+kernel void get_misfit_ellipsoids(global const float *diff_func_values,
+								  global const float *search_origins,
+								  float dx, float dy, float dz,
+								  int nx, int ny, int nz,
+								  float misfit_threshold,
+								  local float *group_values,
+								  local int *group_nodes,
+								  local float *group_moments,
+								  global float *ellipsoids){
+	// one power of two work-group per event, the second NDRange dimension
+	// is the event; ellipsoid row is (nodes count, mean x, y, altitude,
+	// covariance xx, xy, x-alt, yy, y-alt, alt-alt) of nodes whose value
+	// is not more than the minimum of event plus the threshold
+	int local_id = get_local_id(0);
+	int group_size = get_local_size(0);
+	int event_id = get_group_id(1);
+	int nodes_count = nx * ny * nz;
+	global const float *event_values = diff_func_values + event_id * nodes_count;
+
+	float min_diff_function = INFINITY;
+	int minimal_node = NULL_VALUE;
+	for (int i = local_id; i < nodes_count; i += group_size){
+		float diff_func_value = event_values[i];
+		if ((diff_func_value != NULL_VALUE) && (diff_func_value < min_diff_function)){
+			min_diff_function = diff_func_value;
+			minimal_node = i;
+		}
+	}
+	group_values[local_id] = min_diff_function;
+	group_nodes[local_id] = minimal_node;
+	reduce_local_minimum(group_values, group_nodes);
+	min_diff_function = group_values[0];
+	minimal_node = group_nodes[0];
+
+	// moments are accumulated around the minimal node to keep float
+	// precision of the covariance
+	float moments[ELLIPSOID_COLUMNS_COUNT] = {0};
+	int3 minimal_index = {
+		(minimal_node % (nx * ny)) % nx,
+		(minimal_node % (nx * ny)) / nx,
+		minimal_node / (nx * ny)
+	};
+	for (int i = local_id; (minimal_node != NULL_VALUE) && (i < nodes_count); i += group_size){
+		float diff_func_value = event_values[i];
+		if ((diff_func_value == NULL_VALUE) || (diff_func_value > min_diff_function + misfit_threshold)){
+			continue;
+		}
+
+		float3 d = {
+			((i % (nx * ny)) % nx - minimal_index.s0) * dx,
+			((i % (nx * ny)) / nx - minimal_index.s1) * dy,
+			(i / (nx * ny) - minimal_index.s2) * dz
+		};
+		moments[0] += 1;
+		moments[1] += d.s0;
+		moments[2] += d.s1;
+		moments[3] += d.s2;
+		moments[4] += d.s0 * d.s0;
+		moments[5] += d.s0 * d.s1;
+		moments[6] += d.s0 * d.s2;
+		moments[7] += d.s1 * d.s1;
+		moments[8] += d.s1 * d.s2;
+		moments[9] += d.s2 * d.s2;
+	}
+
+	for (int k = 0; k < ELLIPSOID_COLUMNS_COUNT; k++){
+		group_moments[k * group_size + local_id] = moments[k];
+	}
+	for (int step = group_size / 2; step > 0; step /= 2){
+		barrier(CLK_LOCAL_MEM_FENCE);
+		if (local_id < step){
+			for (int k = 0; k < ELLIPSOID_COLUMNS_COUNT; k++){
+				group_moments[k * group_size + local_id] += group_moments[k * group_size + local_id + step];
+			}
+		}
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (local_id != 0){
+		return;
+	}
+
+	global float *ellipsoid = ellipsoids + event_id * ELLIPSOID_COLUMNS_COUNT;
+	float count = group_moments[0];
+	if (count == 0){
+		for (int k = 0; k < ELLIPSOID_COLUMNS_COUNT; k++){
+			ellipsoid[k] = NULL_VALUE;
+		}
+		ellipsoid[0] = 0;
+		return;
+	}
+
+	float3 mean = {
+		group_moments[group_size] / count,
+		group_moments[2 * group_size] / count,
+		group_moments[3 * group_size] / count
+	};
+	ellipsoid[0] = count;
+	ellipsoid[1] = search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT] + minimal_index.s0 * dx + mean.s0;
+	ellipsoid[2] = search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 1] + minimal_index.s1 * dy + mean.s1;
+	ellipsoid[3] = search_origins[event_id * SEARCH_ORIGINS_COLUMNS_COUNT + 2] + minimal_index.s2 * dz + mean.s2;
+	ellipsoid[4] = group_moments[4 * group_size] / count - mean.s0 * mean.s0;
+	ellipsoid[5] = group_moments[5 * group_size] / count - mean.s0 * mean.s1;
+	ellipsoid[6] = group_moments[6 * group_size] / count - mean.s0 * mean.s2;
+	ellipsoid[7] = group_moments[7 * group_size] / count - mean.s1 * mean.s1;
+	ellipsoid[8] = group_moments[8 * group_size] / count - mean.s1 * mean.s2;
+	ellipsoid[9] = group_moments[9 * group_size] / count - mean.s2 * mean.s2;
+}
+
+
+kernel void test_get_model_layer_index_by_altitude(
+	constant float *model, int layers_count, float target_altitude
+	){
+	int global_id = get_global_thread_id();
+
+	if (global_id > 0){
+		return;
+	}
+
+	int index = get_model_layer_index_by_altitude(
+		model, layers_count, target_altitude
+	);
+
+	printf("%i\n", index);
+}
+
+kernel void test_get_ray_constant(float incident_angle, float vp){
+	int global_id = get_global_thread_id();
+
+	if (global_id > 0){
+		return;
+	}
+
+	printf("%f\n", get_ray_constant((ray_float)incident_angle, vp));
+}
+
+kernel void test_is_ray_reflected(constant float *model,
+	int layers_count, float source_altitude,
+	float target_altitude, float incident_angle
+	){
+    int global_id = get_global_thread_id();
+
+	if (global_id > 0){
+		return;
+	}
+
+	bool is_reflected = is_ray_reflected(model, layers_count, source_altitude,
+	target_altitude, (ray_float)incident_angle
+	);
+
+	if (is_reflected){
+		printf("1\n");
+	}
+	else{
+		printf("0\n");
+	}
+}
+
+kernel void test_get_ray_trace(constant float *model, int layers_count,
+	float source_r, float source_altitude, float target_altitude,
+    float incident_angle, int lateral_direction, int frequency
+){
+	int global_id = get_global_thread_id();
+
+	if (global_id > 0){
+		return;
+	}
+
+	float3 ray_point = get_ray_trace(
+		model, layers_count, source_r, source_altitude, target_altitude,
+    	(ray_float)incident_angle, lateral_direction, frequency
+	);
+	printf("%f %f %f\n", ray_point.s0, ray_point.s1, ray_point.s2);
+}
+
+kernel void test_get_min_angle(float delta_altitudes, float accuracy){
+	int global_id = get_global_thread_id();
+
+	if (global_id > 0){
+		return;
+	}
+
+	ray_float min_angle = get_min_angle(delta_altitudes, accuracy);
+	printf("%f\n", min_angle);
+}
+
+kernel void test_get_max_angle(float delta_altitudes, float r_offset){
+	int global_id = get_global_thread_id();
+
+	if (global_id > 0){
+		return;
+	}
+
+	ray_float max_angle = get_max_angle(delta_altitudes, r_offset);
+	printf("%f\n", max_angle);
+}
+
+kernel void test_get_ray_time(constant float *model, int layers_count,
 	float source_r, float source_altitude, float receiver_r,
 	float receiver_altitude, float accuracy, int frequency
 ){
@@ -442,7 +1912,23 @@ kernel void test_get_ray_time(global const float *model, int layers_count,
 	printf("%f\n", time);
 }
 
-kernel void test_get_diff_function(global const float *model, int layers_count,
+kernel void test_get_ray_times(constant float *model, int layers_count,
+	global const float *source_altitudes, global const float *offsets,
+	int rays_count, float receiver_altitude, float accuracy, int frequency,
+	global float *times
+){
+	int global_id = get_global_thread_id();
+
+	if (global_id > rays_count - 1){
+		return;
+	}
+
+	times[global_id] = get_ray_float_time(model, layers_count, 0,
+		source_altitudes[global_id], offsets[global_id], receiver_altitude,
+		accuracy, frequency);
+}
+
+kernel void test_get_diff_function(constant float *model, int layers_count,
 	global const int *real_delays, int stations_count, int events_count,
 	int event_id, global const float *station_coordinates,
 	float stations_altitude, float x_node, float y_node, float z_node,
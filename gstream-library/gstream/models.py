@@ -18,9 +18,12 @@ from gstream.core_models import (
 )
 from gstream.files.binary import CharType, DoubleType, IntType
 
+STREAM_TIMEOUT_SECONDS = 600
+
 
 class TaskType(Enum):
     DELAYS = 'delays'
+    DELAYS_STREAM = 'delays-stream'
     LOCATION = 'location'
     FAULT = 'fault'
 
@@ -39,6 +42,19 @@ class ArrayType(Enum):
     FLOAT32 = 'float32'
 
 
+class DelaysFinderEngine(Enum):
+    DIRECT = 0
+    RUNNING_SUM = 1
+    FFT = 2
+    TILED = 3
+    STATIONS_GRID = 4
+
+
+class RaySolver(Enum):
+    BISECTION = 0
+    NEWTON = 1
+
+
 def check_task_type(type_: str) -> str:
     if type_ in TaskType._value2member_map_:
         return type_
@@ -51,6 +67,18 @@ def check_array_type(type_: str) -> str:
     raise KeyError('Type array is invalid')
 
 
+def check_delays_finder_engine(engine: int) -> int:
+    if engine in DelaysFinderEngine._value2member_map_:
+        return engine
+    raise KeyError('Delays finder engine is invalid')
+
+
+def check_ray_solver(solver: int) -> int:
+    if solver in RaySolver._value2member_map_:
+        return solver
+    raise KeyError('Ray solver is invalid')
+
+
 class CustomBaseModel(BaseModel):
     class Config:
         """Model configuration."""
@@ -127,11 +155,21 @@ class TaskState(CustomBaseModel):
         }
 
     @property
-    def all_filenames(self) -> Tuple[str, str, str]:
+    def stream_filename(self) -> str:
+        return f'{self.input_args_filename}.stream'
+
+    @property
+    def detections_filename(self) -> str:
+        return f'{self.output_args_filename}.detections'
+
+    @property
+    def all_filenames(self) -> Tuple[str, ...]:
         return (
             self.input_args_filename,
             self.script_filename,
-            self.output_args_filename
+            self.output_args_filename,
+            self.stream_filename,
+            self.detections_filename
         )
 
     def rollback(self):
@@ -259,6 +297,13 @@ class DelaysFinderParameters(CustomBaseModel):
         scanner size: scanner size
         min_correlation: minimal correlation value
         base_station_index: base station index
+        engine: correlation engine (see DelaysFinderEngine)
+        chunk_length: time indexes count processed per GPU run
+            (whole signals if 0)
+        gpu_cards_count: count of GPU cards sharing time indexes
+            (all free cards if 0)
+        stream_timeout: seconds without appended blocks after which
+            a delays stream is closed (never closed by timeout if 0)
 
     """
 
@@ -267,6 +312,24 @@ class DelaysFinderParameters(CustomBaseModel):
     scanner_size: int = Field(alias='ScannerSize')
     min_correlation: float = Field(alias='MinCorrelation')
     base_station_index: int = Field(alias='BaseStationIndex')
+    engine: int = Field(
+        alias='Engine',
+        default=DelaysFinderEngine.DIRECT.value
+    )
+
+    chunk_length: int = Field(alias='ChunkLength', default=0, ge=0)
+    gpu_cards_count: int = Field(alias='GPUCardsCount', default=1, ge=0)
+    stream_timeout: int = Field(
+        alias='StreamTimeout',
+        default=STREAM_TIMEOUT_SECONDS,
+        ge=0
+    )
+
+    _check_engine = validator(
+        'engine', allow_reuse=True
+    )(
+        lambda value: check_delays_finder_engine(engine=value)
+    )
 
     @property
     def signals_length(self) -> int:
@@ -280,6 +343,12 @@ class DelaysFinderParameters(CustomBaseModel):
     def buffer(self) -> int:
         return self.window_size + self.scanner_size
 
+    @property
+    def chunk_signals_length(self) -> int:
+        if self.chunk_length == 0:
+            return self.signals_length
+        return min(self.signals_length, self.chunk_length + self.buffer)
+
     def convert_to_bytes(self) -> bytes:
         bytes_value = IntType.pack(
             obj=[self.window_size, self.scanner_size]
@@ -289,6 +358,12 @@ class DelaysFinderParameters(CustomBaseModel):
             obj=self.base_station_index
         )
         bytes_value += self.signals.convert_to_bytes()
+        bytes_value += IntType.pack(
+            obj=[
+                self.engine, self.chunk_length, self.gpu_cards_count,
+                self.stream_timeout
+            ]
+        )
         return bytes_value
 
     @staticmethod
@@ -329,7 +404,23 @@ class DelaysFinderParameters(CustomBaseModel):
         )
 
         left_index = right_index
-        array_bytes = bytes_obj[left_index:]
+        right_index += rows_count * cols_count * np.dtype(array_type).itemsize
+        array_bytes = bytes_obj[left_index:right_index]
+
+        # Options are appended after signals, so files written before
+        # an option was introduced are still readable with its default
+        options = {}
+        for option_name in (
+                'engine', 'chunk_length', 'gpu_cards_count', 'stream_timeout'
+        ):
+            left_index = right_index
+            right_index += IntType.byte_size
+            if len(bytes_obj) < right_index:
+                break
+            options[option_name] = IntType.unpack(
+                value=bytes_obj[left_index:right_index],
+                numbers_count=1
+            )
 
         return DelaysFinderParameters(
             signals=Array(
@@ -343,7 +434,8 @@ class DelaysFinderParameters(CustomBaseModel):
             window_size=window_size,
             scanner_size=scanner_size,
             min_correlation=min_correlation,
-            base_station_index=base_station_index
+            base_station_index=base_station_index,
+            **options
         )
 
     @root_validator
@@ -364,6 +456,124 @@ class DiffFunctionParameters(CustomBaseModel):
     signal_frequency: int = Field(alias='SignalFrequency')
     real_delays: np.ndarray = Field(alias='RealDelaysArray')
     search_space_centers: np.ndarray = Field('SearchSpaceCenters')
+    # step of (altitude, offset) travel times table (rays per node if 0)
+    travel_times_step: float = Field(
+        alias='TravelTimesStep',
+        default=0,
+        ge=0
+    )
+    # travel times are calculated once on nodes lattice shared by all
+    # events, search cubes are snapped to it (rays per node if the lattice
+    # has more nodes than the cubes)
+    shared_lattice: bool = Field(alias='SharedLattice', default=False)
+    # lattice misfits are evaluated by tiles of lattice nodes staged in
+    # local memory against blocks of events whose cubes cover them,
+    # missing (NULL) delays are masked out
+    batched_misfits: bool = Field(alias='BatchedMisfits', default=False)
+    # best nodes are refined by finer sub-cubes until the max step is not
+    # more than refinement step (single resolution if 0), sub-cubes are
+    # evaluated by rays per node (by columns with column nodes) whatever
+    # table or lattice evaluated the cube
+    refinement_step: float = Field(alias='RefinementStep', default=0, ge=0)
+    refinement_nodes_count: int = Field(
+        alias='RefinementNodesCount',
+        default=4,
+        ge=1
+    )
+    # minimal nodes are found while cubes are evaluated by rays per node or
+    # table and cubes are not stored (incompatible with refinement, best
+    # nodes or ellipsoids)
+    fused_minimum: bool = Field(alias='FusedMinimum', default=False)
+    # lowest misfit nodes of every event are returned besides the minimum
+    best_nodes_count: int = Field(alias='BestNodesCount', default=0, ge=0)
+    # mean and covariance of nodes whose misfit exceeds the minimum of the
+    # event by not more than threshold (not calculated if 0)
+    misfit_threshold: float = Field(
+        alias='MisfitThreshold',
+        default=0,
+        ge=0
+    )
+    # offsets and times of rays are sampled at this count of ray parameters
+    # for every distinct node altitude, offsets beyond the samples are solved
+    # by rays (rays per node if 0)
+    ray_parameters_count: int = Field(
+        alias='RayParametersCount',
+        default=0,
+        ge=0
+    )
+    # rays per node cubes are evaluated by columns of nodes sharing lateral
+    # station offsets
+    column_nodes: bool = Field(alias='ColumnNodes', default=False)
+    # rays per node evaluation of a node stops once its lower bound exceeds
+    # the best value of the event, only minimal nodes stay exact
+    # (incompatible with refinement, best nodes or ellipsoids)
+    pruned_nodes: bool = Field(alias='PrunedNodes', default=False)
+    # incidence angle bisection or Newton solver by ray parameter
+    ray_solver: int = Field(
+        alias='RaySolver',
+        default=RaySolver.BISECTION.value
+    )
+    # rays are traced in single precision (see README for accuracy)
+    single_precision_rays: bool = Field(
+        alias='SinglePrecisionRays',
+        default=False
+    )
+
+    _check_ray_solver = validator(
+        'ray_solver', allow_reuse=True
+    )(
+        lambda value: check_ray_solver(solver=value)
+    )
+
+    @validator('ray_parameters_count')
+    def __check_ray_parameters_count(cls, value: int) -> int:
+        if value == 1:
+            raise ValueError('Ray parameters count must be 0 or more than 1')
+        return value
+
+    @root_validator
+    def __check_modes(cls, values: dict) -> dict:
+        # cube is evaluated by one of the modes, other options of the
+        # evaluation would be silently ignored
+        cube_modes = [
+            name for name, is_set in (
+                ('SharedLattice', values.get('shared_lattice')),
+                ('TravelTimesStep', values.get('travel_times_step')),
+                ('RayParametersCount', values.get('ray_parameters_count')),
+                ('ColumnNodes', values.get('column_nodes')),
+                ('PrunedNodes', values.get('pruned_nodes'))
+            ) if is_set
+        ]
+        if len(cube_modes) > 1:
+            raise ValueError(
+                f'Incompatible cube modes: {", ".join(cube_modes)}'
+            )
+        # these options read stored exact cubes
+        stored_cube_options = [
+            name for name, is_set in (
+                ('RefinementStep', values.get('refinement_step')),
+                ('BestNodesCount', values.get('best_nodes_count')),
+                ('MisfitThreshold', values.get('misfit_threshold'))
+            ) if is_set
+        ]
+        if values.get('fused_minimum'):
+            if cube_modes not in ([], ['TravelTimesStep']):
+                raise ValueError(
+                    f'Fused minimum is incompatible with {cube_modes[0]}'
+                )
+            if stored_cube_options:
+                raise ValueError(
+                    f'Fused minimum is incompatible with '
+                    f'{", ".join(stored_cube_options)}'
+                )
+        if values.get('pruned_nodes') and stored_cube_options:
+            raise ValueError(
+                f'Pruned nodes are incompatible with '
+                f'{", ".join(stored_cube_options)}'
+            )
+        if values.get('batched_misfits') and not values.get('shared_lattice'):
+            raise ValueError('Batched misfits need shared lattice')
+        return values
 
     @property
     def events_count(self) -> int:
@@ -6,16 +6,18 @@ import subprocess
 from dataclasses import dataclass
 from logging import Logger
 from pathlib import Path
-from typing import List, Tuple, Union
+from typing import Dict, List, Optional, Sequence, Tuple, Union
 
 import pyopencl as cl
 
 from gstream.node.common import MemoryInfo, convert_megabytes_to_bytes
+from gstream.node.program_cache import ProgramCache
 
 MEMORY_FILE_STATS = Path('/proc/meminfo')
 TOTAL_MEMORY_SIZE_KEY = 'MemTotal'
 FREE_MEMORY_SIZE_KEY = 'MemFree'
 MEMORY_SIZE_UNIT_IN_BYTES = 1024
+MAX_CACHED_PROGRAMS_COUNT = 16
 
 __all__ = [
     'GPUCardInfo',
@@ -26,7 +28,8 @@ __all__ = [
     'MEMORY_FILE_STATS',
     'MEMORY_SIZE_UNIT_IN_BYTES',
     'TOTAL_MEMORY_SIZE_KEY',
-    'FREE_MEMORY_SIZE_KEY'
+    'FREE_MEMORY_SIZE_KEY',
+    'MAX_CACHED_PROGRAMS_COUNT'
 ]
 
 GPU_QUERY_CMD = [
@@ -199,6 +202,7 @@ class GPUCard:
         self.__bus_id, self.__uuid = self.__get_bus_id_and_uuid()
         self.__cl_context = cl.Context(devices=[cl_gpu_device])
         self.__cl_queue = cl.CommandQueue(self.__cl_context)
+        self.__cl_programs: Dict[Tuple[str, Tuple[str, ...]], cl.Program] = {}
 
         self.logger.debug(f'Card with uuid {self.__uuid} was activated')
 
@@ -295,19 +299,76 @@ class GPUCard:
         """
         return self.__cl_queue
 
-    def compile_cl_core(self, core: str) -> cl.Program:
+    def __build_cl_binary(
+            self,
+            binary: bytes,
+            options: Sequence[str]
+    ) -> Optional[cl.Program]:
+        try:
+            return cl.Program(
+                self.cl_context, [self.cl_gpu_device], [binary]
+            ).build(options=list(options))
+        except cl.Error:
+            self.logger.warning('Cached CL program binary was not built')
+            return None
+
+    def compile_cl_core(
+            self,
+            core: str,
+            options: Sequence[str] = (),
+            program_cache: Optional[ProgramCache] = None
+    ) -> cl.Program:
         """Return compiled CL kernel.
 
+        Programs are cached by source and build options, so tasks with the
+        same specialization are built once on the card. The oldest program
+        is dropped when the cache is full. With program cache, binaries
+        are also loaded from and saved to disk.
+
         Args:
             core: kernel in line format
+            options: build options (e.g. -D defines of task values)
+            program_cache: on-disk cache of program binaries
 
         Returns: cl.Program
 
         """
-        try:
-            module = cl.Program(self.cl_context, core).build()
-        except cl.RuntimeError:
-            raise
+        key = (core, tuple(options))
+        module = self.__cl_programs.get(key)
+        if module is not None:
+            return module
+
+        binary_key = None
+        if program_cache is not None:
+            binary_key = ProgramCache.get_key(
+                cl_gpu_device=self.cl_gpu_device,
+                core=core,
+                options=options
+            )
+            binary = program_cache.load(key=binary_key)
+            if binary is not None:
+                module = self.__build_cl_binary(
+                    binary=binary,
+                    options=options
+                )
+
+        if module is None:
+            try:
+                module = cl.Program(self.cl_context, core).build(
+                    options=list(options)
+                )
+            except cl.RuntimeError:
+                raise
+
+            if program_cache is not None:
+                program_cache.save(
+                    key=binary_key,
+                    binary=module.get_info(cl.program_info.BINARIES)[0]
+                )
+
+        if len(self.__cl_programs) >= MAX_CACHED_PROGRAMS_COUNT:
+            del self.__cl_programs[next(iter(self.__cl_programs))]
+        self.__cl_programs[key] = module
         return module
 
     @property
@@ -357,6 +418,24 @@ class GPUCard:
         """
         return self.cl_gpu_device.max_work_group_size
 
+    @property
+    def local_memory_size(self) -> int:
+        """Return local memory size of work-group in bytes.
+
+        Returns: int
+
+        """
+        return self.cl_gpu_device.local_mem_size
+
+    @property
+    def compute_units_count(self) -> int:
+        """Return count of GPU compute units.
+
+        Returns: int
+
+        """
+        return self.cl_gpu_device.max_compute_units
+
     @property
     def max_grid_size(self) -> List[int]:
         """Return max GPU grid size.
@@ -478,3 +557,33 @@ class GPURig:
                 return gpu_card
         else:
             raise NoFreeGPUCardException('All GPU card are busy now')
+
+    def get_free_gpu_cards(
+            self,
+            required_memory_size: int,
+            max_cards_count: Optional[int] = None
+    ) -> List[GPUCard]:
+        """Return free GPU cards with enough memory.
+
+        Args:
+            required_memory_size: required memory size on each card
+            max_cards_count: max count of returned cards (all by default)
+
+        Returns: List[GPUCard]
+
+        """
+        gpu_cards = []
+        for gpu_card in self.gpu_cards:
+            if max_cards_count is not None:
+                if len(gpu_cards) >= max_cards_count:
+                    break
+
+            if not gpu_card.is_free:
+                continue
+
+            if gpu_card.memory_info.free_volume > required_memory_size:
+                gpu_cards.append(gpu_card)
+
+        if not gpu_cards:
+            raise NoFreeGPUCardException('All GPU card are busy now')
+        return gpu_cards
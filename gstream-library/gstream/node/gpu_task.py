@@ -1,12 +1,13 @@
 """Module with classes for running processing tasks on GPU."""
 
 from functools import singledispatchmethod
-from typing import List, Union
+from typing import Dict, List, Optional, Tuple, Union
 
 import numpy as np
 import pyopencl as cl
 
 from gstream.node.gpu_rig import GPUCard, NoFreeGPUCardException
+from gstream.node.program_cache import ProgramCache
 
 __all__ = [
     'GPUArray',
@@ -17,16 +18,23 @@ __all__ = [
 class GPUArray:
     """Class for custom GPU array."""
 
-    def __init__(self, src: np.ndarray, is_copy: bool = False):
+    def __init__(
+            self,
+            src: np.ndarray,
+            is_copy: bool = False,
+            is_read_write: bool = False
+    ):
         """Initialize class method.
 
         Args:
             src: source numpy array
             is_copy: is copy to gpu from cpu [bool]
+            is_read_write: is array shared between kernels [bool]
         """
         self.__src = src
 
         self.__is_copy = is_copy
+        self.__is_read_write = is_read_write
         self.__cl_buffer = None
 
     def __eq__(self, other: 'GPUArray') -> bool:
@@ -58,6 +66,10 @@ class GPUArray:
         Returns: int
 
         """
+        if self.__is_read_write:
+            if self.__is_copy:
+                return cl.mem_flags.READ_WRITE | cl.mem_flags.COPY_HOST_PTR
+            return cl.mem_flags.READ_WRITE
         if self.__is_copy:
             return cl.mem_flags.READ_ONLY | cl.mem_flags.COPY_HOST_PTR
         else:
@@ -95,17 +107,53 @@ class GPUArray:
             else:
                 self.__cl_buffer = cl.Buffer(
                     context=cl_context,
-                    flags=cl.mem_flags.WRITE_ONLY,
+                    flags=self.__flags,
                     size=self.__src.nbytes
                 )
         except cl.MemoryError:
             raise NoFreeGPUCardException
 
-    async def get_from_gpu(self, cl_queue: cl.CommandQueue) -> np.ndarray:
+    async def set_to_gpu(
+            self,
+            cl_queue: cl.CommandQueue,
+            src: np.ndarray,
+            rows_count: Optional[int] = None
+    ) -> None:
+        """Replace array data, also in GPU memory if it is loaded.
+
+        Args:
+            cl_queue: CL queue
+            src: source numpy array with the same bytes size (as the
+                leading rows if rows_count is given)
+            rows_count: count of leading rows to replace (all by default)
+
+        Returns: None
+
+        """
+        if rows_count is None:
+            if src.nbytes != self.bytes_size:
+                raise ValueError('Invalid source array bytes size')
+            self.__src = src
+        else:
+            if src.nbytes != self.__src[:rows_count].nbytes:
+                raise ValueError('Invalid source array bytes size')
+            self.__src[:rows_count] = src
+            src = self.__src[:rows_count]
+
+        if self.cl_buffer is not None and src.size > 0:
+            # zero-sized copies are invalid in OpenCL
+            cl.enqueue_copy(cl_queue, self.cl_buffer, src)
+
+    async def get_from_gpu(
+            self,
+            cl_queue: cl.CommandQueue,
+            rows_count: Optional[int] = None
+    ) -> np.ndarray:
         """Copy array from GPU memory to CPU.
 
         Args:
             cl_queue: CL queue
+            rows_count: count of leading rows to copy (all by default)
 
         Returns: numpy array
 
@@ -113,8 +161,14 @@ class GPUArray:
         if self.cl_buffer is None:
             return np.array([])
 
-        cl.enqueue_copy(cl_queue, self.__src, self.cl_buffer)
-        return self.__src
+        dst = self.__src
+        if rows_count is not None:
+            dst = self.__src[:rows_count]
+        if dst.size == 0:
+            # zero-sized copies are invalid in OpenCL
+            return dst
+        cl.enqueue_copy(cl_queue, dst, self.cl_buffer)
+        return dst
 
     def release(self) -> None:
         """Release CL buffer.
@@ -132,16 +186,30 @@ class GPUArray:
 class GPUTask:
     """Class for comfort running gpu cores."""
 
-    def __init__(self, gpu_card: GPUCard, core: str):
+    def __init__(
+            self,
+            gpu_card: GPUCard,
+            core: str,
+            definitions: Optional[Dict[str, Union[int, float, None]]] = None,
+            program_cache: Optional[ProgramCache] = None
+    ):
         """Initialize class method.
 
         Args:
             gpu_card: GPUCard
             core: src core [str]
+            definitions: task values defined for the core at build time,
+                None value defines a flag
+            program_cache: on-disk cache of program binaries
         """
         self.__gpu_card = gpu_card
         self.core = core
-        self.__cl_module = gpu_card.compile_cl_core(core=self.core)
+        self.definitions = definitions or {}
+        self.__cl_module = gpu_card.compile_cl_core(
+            core=self.core,
+            options=self.build_options,
+            program_cache=program_cache
+        )
         self.__gpu_args = []
 
     def __eq__(self, other: 'GPUTask') -> bool:
@@ -153,7 +221,11 @@ class GPUTask:
         Returns:
             True if both GPUTask objects are equal, otherwise - False
         """
-        return self.__gpu_card == other.gpu_card and self.core == other.core
+        return all((
+            self.__gpu_card == other.gpu_card,
+            self.core == other.core,
+            self.definitions == other.definitions
+        ))
 
     def __ne__(self, other: 'GPUTask') -> bool:
         """Compares GPUTask object with other GPUTask object for inequality.
@@ -176,10 +248,27 @@ class GPUTask:
         return self.__gpu_card
 
     @property
-    def gpu_args(self) -> List[Union[np.int32, np.float32, cl.Buffer]]:
+    def build_options(self) -> List[str]:
+        """Return build options defining task values for the core.
+
+        Returns: List[str]
+
+        """
+        options = []
+        for name, value in sorted(self.definitions.items()):
+            if value is None:
+                options.append(f'-D{name}')
+            else:
+                options.append(f'-D{name}={value}')
+        return options
+
+    @property
+    def gpu_args(
+            self
+    ) -> List[Union[np.int32, np.float32, cl.Buffer, cl.LocalMemory]]:
         """Return list of arguments for OpenCL task.
 
-        Returns: List[Union[np.int32, np.float32, cl.Buffer]]
+        Returns: List[Union[np.int32, np.float32, cl.Buffer, cl.LocalMemory]]
 
         """
         return self.__gpu_args
@@ -196,6 +285,10 @@ class GPUTask:
     async def __convert_from(self, arg: float) -> np.float32:
         return np.float32(arg)
 
+    @__convert_to_gpu_type.register
+    async def __convert_from(self, arg: cl.LocalMemory) -> cl.LocalMemory:
+        return arg
+
     @__convert_to_gpu_type.register
     async def __convert_from(self, arg: GPUArray) -> cl.Buffer:
         if arg.cl_buffer is None:
@@ -204,7 +297,7 @@ class GPUTask:
 
     async def __load_args(
             self,
-            args: List[Union[int, float, GPUArray]]
+            args: List[Union[int, float, GPUArray, cl.LocalMemory]]
     ) -> None:
         """Load list of gpu args.
 
@@ -218,12 +311,20 @@ class GPUTask:
             gpu_args.append(await self.__convert_to_gpu_type(args[i]))
         self.__gpu_args = gpu_args
 
-    async def run(self, function_name: str, args: list) -> None:
+    async def run(
+            self,
+            function_name: str,
+            args: list,
+            global_size: Optional[Tuple[int, ...]] = None,
+            local_size: Optional[Tuple[int, ...]] = None
+    ) -> None:
         """Run gpu task.
 
         Args:
             function_name: function name
             args: args list
+            global_size: NDRange size (max grid size by default)
+            local_size: work-group size (chosen by driver by default)
 
         Returns: None
 
@@ -234,9 +335,12 @@ class GPUTask:
         except NoFreeGPUCardException:
             raise
 
+        if global_size is None:
+            global_size = self.gpu_card.max_grid_size
+
         try:
             cl_function(
-                self.gpu_card.cl_queue, self.gpu_card.max_grid_size, None,
+                self.gpu_card.cl_queue, global_size, local_size,
                 *self.gpu_args
             )
         except cl.RuntimeError:
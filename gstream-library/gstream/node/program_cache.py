@@ -0,0 +1,147 @@
+"""Module with on-disk cache of built CL programs."""
+
+import hashlib
+import logging
+import os
+import tempfile
+from logging import Logger
+from pathlib import Path
+from typing import Optional, Sequence
+
+import pyopencl as cl
+
+PROGRAMS_FOLDER_SUFFIX = '-programs'
+PROGRAM_FILE_EXTENSION = '.bin'
+
+__all__ = [
+    'ProgramCache',
+    'PROGRAMS_FOLDER_SUFFIX',
+    'PROGRAM_FILE_EXTENSION'
+]
+
+
+class ProgramCache:
+    """Folder with binaries of CL programs built on the node.
+
+    Every task runs in a fresh process, so programs are kept on disk to
+    skip compilation of the same kernels. Binary is keyed by the device,
+    its driver version, build options and source hash.
+
+    """
+
+    def __init__(self, root: Path):
+        """Initialize class method.
+
+        Args:
+            root: folder of program binaries, created on first save
+        """
+        self.__logger = logging.getLogger('ProgramCache')
+        self.__root = root
+
+    @classmethod
+    def create_next_to(cls, storage_root: Path) -> 'ProgramCache':
+        """Return cache in the folder next to the file storage root.
+
+        Args:
+            storage_root: root of file storage
+
+        Returns: ProgramCache
+
+        """
+        return cls(
+            root=Path(
+                storage_root.parent,
+                f'{storage_root.name}{PROGRAMS_FOLDER_SUFFIX}'
+            )
+        )
+
+    @property
+    def logger(self) -> Logger:
+        """Return logger.
+
+        Returns: Logger
+
+        """
+        return self.__logger
+
+    @property
+    def root(self) -> Path:
+        """Return folder of program binaries.
+
+        Returns: Path
+
+        """
+        return self.__root
+
+    @staticmethod
+    def get_key(
+            cl_gpu_device: cl.Device,
+            core: str,
+            options: Sequence[str] = ()
+    ) -> str:
+        """Return key of program binary.
+
+        Args:
+            cl_gpu_device: CL GPU device
+            core: kernel in line format
+            options: build options
+
+        Returns: str
+
+        """
+        fields = [
+            cl_gpu_device.vendor,
+            cl_gpu_device.name,
+            cl_gpu_device.driver_version,
+            cl_gpu_device.version,
+            *options,
+            hashlib.sha256(core.encode()).hexdigest()
+        ]
+        return hashlib.sha256('\0'.join(fields).encode()).hexdigest()
+
+    def __get_path(self, key: str) -> Path:
+        return Path(self.root, f'{key}{PROGRAM_FILE_EXTENSION}')
+
+    def load(self, key: str) -> Optional[bytes]:
+        """Return program binary or None if it was not saved.
+
+        Args:
+            key: key of program binary
+
+        Returns: Optional[bytes]
+
+        """
+        path = self.__get_path(key=key)
+        try:
+            return path.read_bytes()
+        except OSError:
+            return None
+
+    def save(self, key: str, binary: bytes) -> None:
+        """Save program binary.
+
+        File is replaced at once, so processes building the same program
+        never read a partially written binary. Cache is optional for
+        running tasks, so write errors are only logged.
+
+        Args:
+            key: key of program binary
+            binary: program binary
+
+        Returns: None
+
+        """
+        temp_path = None
+        try:
+            self.root.mkdir(parents=True, exist_ok=True)
+            file_descriptor, temp_path = tempfile.mkstemp(dir=self.root)
+            with os.fdopen(file_descriptor, 'wb') as file_ctx:
+                file_ctx.write(binary)
+            os.replace(temp_path, self.__get_path(key=key))
+        except OSError as e:
+            self.logger.warning(f'Program binary was not cached: {e}')
+            if temp_path is not None:
+                try:
+                    os.unlink(temp_path)
+                except OSError:
+                    pass
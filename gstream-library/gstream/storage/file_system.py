@@ -39,12 +39,22 @@ class Storage:
         async with async_file.open(path, 'wb') as file_ctx:
             await file_ctx.write(data)
 
-    async def get_binary_data_from_file(self, filename: str) -> bytes:
+    async def append_binary_data(self, data: bytes, filename: str):
+        path = Path(self.root, filename)
+        async with async_file.open(path, 'ab') as file_ctx:
+            await file_ctx.write(data)
+
+    async def get_binary_data_from_file(
+            self,
+            filename: str,
+            offset: int = 0
+    ) -> bytes:
         path = Path(self.root, filename)
         if not path.exists():
             raise FileNotFoundError(f'Binary file {filename} not found')
 
         async with async_file.open(path, 'rb') as file_ctx:
+            await file_ctx.seek(offset)
             return await file_ctx.read()
 
     def remove_file(self, filename: str):
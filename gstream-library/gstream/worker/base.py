@@ -13,6 +13,7 @@ from gstream.node.gpu_rig import (
     NoFreeRAMException
 )
 from gstream.node.gpu_task import GPUArray, GPUTask
+from gstream.node.program_cache import ProgramCache
 from gstream.storage.file_system import Storage as FileStorage
 from gstream.storage.redis import Storage as RedisStorage
 
@@ -207,6 +208,12 @@ class GPUProcess(BaseProcess):
         with path.open() as file_ctx:
             return file_ctx.read()
 
+    @property
+    def program_cache(self) -> ProgramCache:
+        return ProgramCache.create_next_to(
+            storage_root=self.file_storage.root
+        )
+
     @property
     async def _task(self) -> GPUTask:
         if self.__task is None:
@@ -1,9 +1,22 @@
+import asyncio
+import sys
+from concurrent.futures import ThreadPoolExecutor
+from math import ceil
 from pathlib import Path
+from typing import List, Optional, Tuple
 
 import numpy as np
+import pyopencl as cl
 
 from gstream.files.writers import DelaysFinderResultBinaryFile
-from gstream.models import Array, ArraySize, ArrayType, DelaysFinderParameters
+from gstream.models import (
+    Array,
+    ArraySize,
+    ArrayType,
+    DelaysFinderEngine,
+    DelaysFinderParameters
+)
+from gstream.node.gpu_rig import GPUCard, GPURig
 from gstream.node.gpu_task import GPUArray, GPUTask
 from gstream.storage.file_system import Storage as FileStorage
 from gstream.storage.redis import Storage as RedisStorage
@@ -11,21 +24,40 @@ from gstream.worker.base import GPUProcess
 
 KERNEL_FILENAME = 'delays_finder.c'
 FUNCTION_NAME = 'get_real_delays'
+SEGMENT_REPEATS_FUNCTION_NAME = 'count_segment_repeats'
+SCAN_REPEATS_FUNCTION_NAME = 'scan_segment_repeats'
+REPEATS_PREFIX_FUNCTION_NAME = 'fill_repeats_prefix'
+REPEATS_SEGMENT_LENGTH = 1024
+LAG_CORRELATIONS_FUNCTION_NAME = 'get_lag_correlations'
+SELECTION_FUNCTION_NAME = 'select_real_delays'
+FFT_WINDOWS_FUNCTION_NAME = 'fill_fft_windows'
+FFT_PASS_FUNCTION_NAME = 'fft_radix2_pass'
+FFT_MULTIPLY_FUNCTION_NAME = 'multiply_fft_spectra'
+FFT_SELECTION_FUNCTION_NAME = 'select_fft_delays'
+FORWARD_FFT_DIRECTION, INVERSE_FFT_DIRECTION = -1, 1
+TILED_FUNCTION_NAME = 'get_real_delays_tiled'
+TILED_GROUP_SIZE = 64
+STATIONS_GRID_FUNCTION_NAME = 'get_station_delays'
+STATIONS_COUNT_FUNCTION_NAME = 'count_selected_stations'
+COMPACTION_FUNCTION_NAME = 'compact_real_delays'
+ACCEPTED_DELAYS_CAPACITY = 16384
+SIMILARITY_MASKS_FUNCTION_NAME = 'get_similarity_masks'
+DISTINCT_SELECTION_FUNCTION_NAME = 'select_distinct_delays'
+DISTINCT_SELECTION_GROUP_SIZE = 256
+RUNNING_SUM_SEGMENT_LENGTH = 256
+MAX_CORRELATIONS_BLOCK_BYTES_SIZE = 256 * 1024 ** 2
+MAX_SPECTRA_BLOCK_BYTES_SIZE = 256 * 1024 ** 2
 SIMILARITY_COEFFICIENT = 0.8
 TIME_EPSILON = 5
 NULL_VALUE = -9999
 
 
-def get_similarity_coeff(row_a: np.ndarray, row_b: np.ndarray,
-                         time_epsilon: int) -> float:
-    if row_a.shape[0] != row_b.shape[0]:
-        raise ValueError('Different sizes of rows')
-
-    diff_values = np.abs(row_a - row_b)
-    t = diff_values[
-        (diff_values <= time_epsilon) + (diff_values > abs(NULL_VALUE) / 2)
-    ]
-    return t.shape[0] / row_a.shape[0]
+def get_min_similar_count(values_count: int) -> int:
+    # searched directly to keep the float comparison of similarity ratio
+    for similar_count in range(values_count + 1):
+        if similar_count / values_count >= SIMILARITY_COEFFICIENT:
+            return similar_count
+    return values_count + 1
 
 
 class DelaysFinder(GPUProcess):
@@ -51,22 +83,22 @@ class DelaysFinder(GPUProcess):
     async def _prepare_args(self):
         args: DelaysFinderParameters = await self._args
         gpu_signals = GPUArray(
-            src=args.signals.convert_to_numpy_format(),
+            src=self.__get_chunk_signals(args=args, start_time_index=0),
             is_copy=True
         )
 
-        processing_signal_length = args.signals_length - args.buffer
+        processing_signal_length = args.chunk_signals_length - args.buffer
         stations_count = args.stations_count
 
         result_array = np.zeros(
             shape=(processing_signal_length, stations_count + 1),
             dtype=np.int32
         )
-        gpu_solution = GPUArray(src=result_array)
+        gpu_solution = GPUArray(src=result_array, is_read_write=True)
 
-        return [
+        prepared_args = [
             gpu_signals,
-            int(args.signals_length),
+            int(args.chunk_signals_length),
             int(args.stations_count),
             int(args.scanner_size),
             int(args.window_size),
@@ -75,12 +107,153 @@ class DelaysFinder(GPUProcess):
             gpu_solution
         ]
 
+        if args.engine == DelaysFinderEngine.RUNNING_SUM.value:
+            correlations = np.zeros(
+                shape=(
+                    self.__get_correlations_block_length(
+                        args=args,
+                        processing_signal_length=processing_signal_length
+                    ),
+                    stations_count,
+                    args.scanner_size
+                ),
+                dtype=np.float32
+            )
+            prepared_args.append(
+                GPUArray(src=correlations, is_read_write=True)
+            )
+        elif args.engine == DelaysFinderEngine.FFT.value:
+            for _ in range(2):
+                spectra = np.zeros(
+                    shape=(
+                        self.__get_spectra_block_length(
+                            args=args,
+                            processing_signal_length=processing_signal_length
+                        ),
+                        stations_count,
+                        self.__get_fft_size(args=args),
+                        2
+                    ),
+                    dtype=np.float32
+                )
+                prepared_args.append(
+                    GPUArray(src=spectra, is_read_write=True)
+                )
+        else:
+            repeats_prefix = np.zeros(
+                shape=(stations_count, args.chunk_signals_length),
+                dtype=np.int32
+            )
+            segments_repeats = np.zeros(
+                shape=(
+                    stations_count,
+                    ceil(args.chunk_signals_length / REPEATS_SEGMENT_LENGTH)
+                ),
+                dtype=np.int32
+            )
+            prepared_args += [
+                GPUArray(src=repeats_prefix, is_read_write=True),
+                GPUArray(src=segments_repeats, is_read_write=True)
+            ]
+
+        prepared_args += [
+            GPUArray(
+                src=np.zeros(shape=1, dtype=np.int32),
+                is_copy=True,
+                is_read_write=True
+            ),
+            GPUArray(
+                src=self._get_accepted_delays_array(
+                    rows_count=processing_signal_length,
+                    stations_count=stations_count
+                )
+            )
+        ]
+        return prepared_args
+
+    @staticmethod
+    def _get_accepted_delays_array(
+            rows_count: int,
+            stations_count: int
+    ) -> np.ndarray:
+        # accepted rows are a small part of the solution, rows over the
+        # capacity are taken from the whole solution
+        return np.zeros(
+            shape=(
+                min(rows_count, ACCEPTED_DELAYS_CAPACITY),
+                stations_count + 1
+            ),
+            dtype=np.int32
+        )
+
+    @staticmethod
+    def __get_chunk_signals(
+            args: DelaysFinderParameters,
+            start_time_index: int
+    ) -> np.ndarray:
+        signals = args.signals.convert_to_numpy_format()
+        if args.chunk_signals_length == args.signals_length:
+            return signals
+
+        # the last chunk is padded, its padded time indexes are not compacted
+        chunk_signals = np.zeros(
+            shape=(args.stations_count, args.chunk_signals_length),
+            dtype=signals.dtype
+        )
+        end_time_index = min(
+            start_time_index + args.chunk_signals_length, args.signals_length
+        )
+        chunk_signals[:, :end_time_index - start_time_index] = signals[
+            :, start_time_index:end_time_index
+        ]
+        return chunk_signals
+
+    @staticmethod
+    def __get_fft_size(args: DelaysFinderParameters) -> int:
+        fft_size = 2
+        while fft_size < args.window_size + args.scanner_size - 1:
+            fft_size *= 2
+        return fft_size
+
+    @classmethod
+    def __get_spectra_block_length(
+            cls,
+            args: DelaysFinderParameters,
+            processing_signal_length: int
+    ) -> int:
+        item_size = 2 * np.dtype(np.float32).itemsize
+        fft_size = cls.__get_fft_size(args=args)
+        block_bytes_size = args.stations_count * fft_size * item_size
+        block_length = MAX_SPECTRA_BLOCK_BYTES_SIZE // block_bytes_size
+        return max(1, min(processing_signal_length, block_length))
+
+    @staticmethod
+    def __get_correlations_block_length(
+            args: DelaysFinderParameters,
+            processing_signal_length: int
+    ) -> int:
+        item_size = np.dtype(np.float32).itemsize
+        block_bytes_size = args.stations_count * args.scanner_size * item_size
+        block_length = MAX_CORRELATIONS_BLOCK_BYTES_SIZE // block_bytes_size
+        return max(1, min(processing_signal_length, block_length))
+
+    @staticmethod
+    def _get_kernel_definitions(args: DelaysFinderParameters) -> dict:
+        # row loops of delays kernels are specialized by the task values
+        return {
+            'STATIONS_COUNT': args.stations_count,
+            'SCANNER_SIZE': args.scanner_size,
+            'WINDOW_SIZE': args.window_size
+        }
+
     async def _create_task(self) -> GPUTask:
         await self.add_log_message(text='Creating GPU task...')
 
         task = GPUTask(
             gpu_card=await self.gpu_card,
-            core=self._get_kernel_core(kernel_filename=KERNEL_FILENAME)
+            core=self._get_kernel_core(kernel_filename=KERNEL_FILENAME),
+            definitions=self._get_kernel_definitions(args=await self._args),
+            program_cache=self.program_cache
         )
 
         await self.add_log_message(text='GPU task was created')
@@ -103,19 +276,698 @@ class DelaysFinder(GPUProcess):
         )
         await writer.save()
 
-    async def _run(self):
-        await self.add_log_message(text='Finding real delays starting ...')
-        prepared_args = await self._prepared_args
+    async def _run_repeats_prefix(
+            self,
+            gpu_signals: GPUArray,
+            signals_length: int,
+            stations_count: int,
+            gpu_repeats_prefix: GPUArray,
+            gpu_segments_repeats: GPUArray,
+            first_index: int = 0,
+            last_index: Optional[int] = None
+    ):
         task = await self._task
+
+        # prefix is filled by segments of [first_index, last_index) only,
+        # it is consistent within these indexes
+        if last_index is None:
+            last_index = signals_length
+        first_segment_index = first_index // REPEATS_SEGMENT_LENGTH
+        segments_count = (
+            ceil(last_index / REPEATS_SEGMENT_LENGTH) - first_segment_index
+        )
+        await task.run(
+            function_name=SEGMENT_REPEATS_FUNCTION_NAME,
+            args=[
+                gpu_signals,
+                signals_length,
+                stations_count,
+                REPEATS_SEGMENT_LENGTH,
+                first_segment_index,
+                segments_count,
+                gpu_segments_repeats
+            ],
+            global_size=(stations_count * segments_count,)
+        )
+        await task.run(
+            function_name=SCAN_REPEATS_FUNCTION_NAME,
+            args=[
+                stations_count,
+                segments_count,
+                gpu_segments_repeats
+            ],
+            global_size=(stations_count,)
+        )
+        await task.run(
+            function_name=REPEATS_PREFIX_FUNCTION_NAME,
+            args=[
+                gpu_signals,
+                signals_length,
+                stations_count,
+                REPEATS_SEGMENT_LENGTH,
+                first_segment_index,
+                segments_count,
+                gpu_segments_repeats,
+                gpu_repeats_prefix
+            ],
+            global_size=(stations_count * segments_count,)
+        )
+
+    async def __run_direct(self):
+        (
+            gpu_signals, signals_length, stations_count, scanner_size,
+            window_size, min_correlation, base_station_index, gpu_solution,
+            gpu_repeats_prefix, gpu_segments_repeats, *_
+        ) = await self._prepared_args
+        task = await self._task
+
+        await self._run_repeats_prefix(
+            gpu_signals=gpu_signals,
+            signals_length=signals_length,
+            stations_count=stations_count,
+            gpu_repeats_prefix=gpu_repeats_prefix,
+            gpu_segments_repeats=gpu_segments_repeats
+        )
         await task.run(
             function_name=FUNCTION_NAME,
-            args=prepared_args
+            args=[
+                gpu_signals,
+                gpu_repeats_prefix,
+                signals_length,
+                stations_count,
+                scanner_size,
+                window_size,
+                min_correlation,
+                base_station_index,
+                gpu_solution
+            ]
+        )
+
+    async def __run_running_sum(self):
+        (
+            gpu_signals, signals_length, stations_count, scanner_size,
+            window_size, min_correlation, base_station_index, gpu_solution,
+            gpu_correlations, *_
+        ) = await self._prepared_args
+        task = await self._task
+
+        args: DelaysFinderParameters = await self._args
+        processing_signal_length = args.chunk_signals_length - args.buffer
+        block_length = self.__get_correlations_block_length(
+            args=args, processing_signal_length=processing_signal_length
+        )
+        segments_count = ceil(block_length / RUNNING_SUM_SEGMENT_LENGTH)
+
+        for start_time_index in range(
+                0, processing_signal_length, block_length
+        ):
+            await task.run(
+                function_name=LAG_CORRELATIONS_FUNCTION_NAME,
+                args=[
+                    gpu_signals,
+                    signals_length,
+                    stations_count,
+                    scanner_size,
+                    window_size,
+                    base_station_index,
+                    start_time_index,
+                    block_length,
+                    processing_signal_length,
+                    RUNNING_SUM_SEGMENT_LENGTH,
+                    gpu_correlations
+                ],
+                global_size=(segments_count * stations_count * scanner_size,)
+            )
+            await task.run(
+                function_name=SELECTION_FUNCTION_NAME,
+                args=[
+                    gpu_correlations,
+                    stations_count,
+                    scanner_size,
+                    min_correlation,
+                    base_station_index,
+                    start_time_index,
+                    block_length,
+                    processing_signal_length,
+                    gpu_solution
+                ],
+                global_size=(block_length,)
+            )
+
+    async def __run_fft_passes(
+            self,
+            input_spectra: GPUArray,
+            output_spectra: GPUArray,
+            fft_size: int,
+            transforms_count: int,
+            direction: int
+    ) -> GPUArray:
+        task = await self._task
+        pass_size = 1
+        while pass_size < fft_size:
+            await task.run(
+                function_name=FFT_PASS_FUNCTION_NAME,
+                args=[
+                    input_spectra,
+                    output_spectra,
+                    fft_size,
+                    transforms_count,
+                    pass_size,
+                    direction
+                ],
+                global_size=(transforms_count * fft_size // 2,)
+            )
+            input_spectra, output_spectra = output_spectra, input_spectra
+            pass_size *= 2
+        return input_spectra
+
+    async def __run_fft(self):
+        (
+            gpu_signals, signals_length, stations_count, scanner_size,
+            window_size, min_correlation, base_station_index, gpu_solution,
+            gpu_spectra, gpu_work_spectra, *_
+        ) = await self._prepared_args
+        task = await self._task
+
+        args: DelaysFinderParameters = await self._args
+        processing_signal_length = args.chunk_signals_length - args.buffer
+        block_length = self.__get_spectra_block_length(
+            args=args, processing_signal_length=processing_signal_length
+        )
+        fft_size = self.__get_fft_size(args=args)
+        block_size = block_length * stations_count * fft_size
+
+        for start_time_index in range(
+                0, processing_signal_length, block_length
+        ):
+            await task.run(
+                function_name=FFT_WINDOWS_FUNCTION_NAME,
+                args=[
+                    gpu_signals,
+                    signals_length,
+                    stations_count,
+                    scanner_size,
+                    window_size,
+                    base_station_index,
+                    start_time_index,
+                    block_length,
+                    processing_signal_length,
+                    fft_size,
+                    gpu_spectra
+                ],
+                global_size=(block_size,)
+            )
+            spectra = await self.__run_fft_passes(
+                input_spectra=gpu_spectra,
+                output_spectra=gpu_work_spectra,
+                fft_size=fft_size,
+                transforms_count=block_length * stations_count,
+                direction=FORWARD_FFT_DIRECTION
+            )
+            await task.run(
+                function_name=FFT_MULTIPLY_FUNCTION_NAME,
+                args=[
+                    spectra,
+                    stations_count,
+                    base_station_index,
+                    block_length,
+                    fft_size
+                ],
+                global_size=(block_size,)
+            )
+            work_spectra = gpu_work_spectra
+            if spectra is gpu_work_spectra:
+                work_spectra = gpu_spectra
+            cross_correlations = await self.__run_fft_passes(
+                input_spectra=spectra,
+                output_spectra=work_spectra,
+                fft_size=fft_size,
+                transforms_count=block_length * stations_count,
+                direction=INVERSE_FFT_DIRECTION
+            )
+            await task.run(
+                function_name=FFT_SELECTION_FUNCTION_NAME,
+                args=[
+                    cross_correlations,
+                    gpu_signals,
+                    signals_length,
+                    stations_count,
+                    scanner_size,
+                    window_size,
+                    min_correlation,
+                    base_station_index,
+                    start_time_index,
+                    block_length,
+                    processing_signal_length,
+                    fft_size,
+                    gpu_solution
+                ],
+                global_size=(block_length,)
+            )
+
+    async def __run_tiled(self):
+        (
+            gpu_signals, signals_length, stations_count, scanner_size,
+            window_size, min_correlation, base_station_index, gpu_solution,
+            *_
+        ) = await self._prepared_args
+        task = await self._task
+
+        group_size = min(TILED_GROUP_SIZE, task.gpu_card.max_block_size)
+        item_size = np.dtype(np.float32).itemsize
+        base_span_size = group_size + window_size - 1
+        station_span_size = (
+            task.gpu_card.local_memory_size // item_size - base_span_size
+        )
+        delays_tile_size = min(
+            scanner_size, station_span_size - group_size - window_size + 2
+        )
+        if delays_tile_size < 1:
+            await self.add_log_message(
+                text='Window is too large for local memory, '
+                     'direct engine is used'
+            )
+            await self.__run_direct()
+            return
+
+        station_span_size = group_size + window_size + delays_tile_size - 2
+        processing_signal_length = signals_length - window_size - scanner_size
+        groups_count = ceil(processing_signal_length / group_size)
+        await task.run(
+            function_name=TILED_FUNCTION_NAME,
+            args=[
+                gpu_signals,
+                signals_length,
+                stations_count,
+                scanner_size,
+                window_size,
+                min_correlation,
+                base_station_index,
+                delays_tile_size,
+                cl.LocalMemory(base_span_size * item_size),
+                cl.LocalMemory(station_span_size * item_size),
+                gpu_solution
+            ],
+            global_size=(groups_count * group_size,),
+            local_size=(group_size,)
+        )
+
+    async def __run_stations_grid(self):
+        (
+            gpu_signals, signals_length, stations_count, scanner_size,
+            window_size, min_correlation, base_station_index, gpu_solution,
+            gpu_repeats_prefix, gpu_segments_repeats, *_
+        ) = await self._prepared_args
+        task = await self._task
+
+        await self._run_repeats_prefix(
+            gpu_signals=gpu_signals,
+            signals_length=signals_length,
+            stations_count=stations_count,
+            gpu_repeats_prefix=gpu_repeats_prefix,
+            gpu_segments_repeats=gpu_segments_repeats
+        )
+        processing_signal_length = signals_length - window_size - scanner_size
+        await task.run(
+            function_name=STATIONS_GRID_FUNCTION_NAME,
+            args=[
+                gpu_signals,
+                gpu_repeats_prefix,
+                signals_length,
+                stations_count,
+                scanner_size,
+                window_size,
+                min_correlation,
+                base_station_index,
+                gpu_solution
+            ],
+            global_size=(processing_signal_length, stations_count)
+        )
+        await task.run(
+            function_name=STATIONS_COUNT_FUNCTION_NAME,
+            args=[
+                processing_signal_length,
+                stations_count,
+                base_station_index,
+                gpu_solution
+            ],
+            global_size=(processing_signal_length,)
+        )
+
+    async def _compact_solution(
+            self,
+            processing_signal_length: int
+    ) -> np.ndarray:
+        prepared_args = await self._prepared_args
+        task = await self._task
+
+        args: DelaysFinderParameters = await self._args
+        stations_count = args.stations_count
+        gpu_solution: GPUArray = prepared_args[7]
+        gpu_accepted_count, gpu_accepted_delays = prepared_args[-2:]
+        accepted_capacity = gpu_accepted_delays.bytes_size // (
+            np.dtype(np.int32).itemsize * (stations_count + 1)
+        )
+        await task.run(
+            function_name=COMPACTION_FUNCTION_NAME,
+            args=[
+                gpu_solution,
+                processing_signal_length,
+                stations_count,
+                accepted_capacity,
+                gpu_accepted_count,
+                gpu_accepted_delays
+            ],
+            global_size=(processing_signal_length,)
+        )
+
+        accepted_count = int(
+            (await gpu_accepted_count.get_from_gpu(
+                cl_queue=task.gpu_card.cl_queue
+            ))[0]
+        )
+        if accepted_count > accepted_capacity:
+            await self.add_log_message(
+                text=f'Accepted delays count {accepted_count} is over '
+                     f'capacity, the whole solution is read'
+            )
+            solution = await gpu_solution.get_from_gpu(
+                cl_queue=task.gpu_card.cl_queue,
+                rows_count=processing_signal_length
+            )
+            time_indexes = np.flatnonzero(solution[:, 0] == 1)
+            return np.insert(
+                solution[time_indexes, 1:], 0, time_indexes, axis=1
+            ).astype(np.int32)
+
+        accepted_delays = await gpu_accepted_delays.get_from_gpu(
+            cl_queue=task.gpu_card.cl_queue,
+            rows_count=accepted_count
         )
+        return accepted_delays[
+            np.argsort(accepted_delays[:, 0], kind='stable')
+        ]
+
+    async def _select_distinct_delays(self):
+        task = await self._task
+        args: DelaysFinderParameters = await self._args
+        rows_count = self._solution.shape[0]
+        durations = np.zeros(shape=rows_count, dtype=np.int32)
+
+        if rows_count > 0:
+            masks_count = max(1, ceil(args.scanner_size / 32))
+            gpu_accepted_delays = GPUArray(src=self._solution, is_copy=True)
+            gpu_similarity_masks = GPUArray(
+                src=np.zeros(shape=(rows_count, masks_count), dtype=np.uint32),
+                is_read_write=True
+            )
+            gpu_durations = GPUArray(src=durations, is_read_write=True)
+            await task.run(
+                function_name=SIMILARITY_MASKS_FUNCTION_NAME,
+                args=[
+                    gpu_accepted_delays,
+                    rows_count,
+                    int(args.stations_count),
+                    int(args.scanner_size),
+                    TIME_EPSILON,
+                    get_min_similar_count(values_count=args.stations_count),
+                    masks_count,
+                    gpu_similarity_masks
+                ],
+                global_size=(rows_count * masks_count,)
+            )
+
+            group_size = min(
+                DISTINCT_SELECTION_GROUP_SIZE, task.gpu_card.max_block_size
+            )
+            await task.run(
+                function_name=DISTINCT_SELECTION_FUNCTION_NAME,
+                args=[
+                    gpu_similarity_masks,
+                    rows_count,
+                    int(args.scanner_size),
+                    masks_count,
+                    cl.LocalMemory(np.dtype(np.int32).itemsize),
+                    gpu_durations
+                ],
+                global_size=(group_size,),
+                local_size=(group_size,)
+            )
+            durations = await gpu_durations.get_from_gpu(
+                cl_queue=task.gpu_card.cl_queue
+            )
+            for gpu_array in (
+                    gpu_accepted_delays, gpu_similarity_masks, gpu_durations
+            ):
+                gpu_array.release()
+
+        is_selected = durations != NULL_VALUE
+        solution = np.insert(self._solution, 1, args.window_size, axis=1)
+        solution = solution[is_selected]
+        solution[:, 1] += durations[is_selected]
+        self._solution = solution
+
+    async def __run_engine(self):
+        args: DelaysFinderParameters = await self._args
+        if args.engine == DelaysFinderEngine.RUNNING_SUM.value:
+            await self.__run_running_sum()
+        elif args.engine == DelaysFinderEngine.FFT.value:
+            await self.__run_fft()
+        elif args.engine == DelaysFinderEngine.TILED.value:
+            await self.__run_tiled()
+        elif args.engine == DelaysFinderEngine.STATIONS_GRID.value:
+            await self.__run_stations_grid()
+        else:
+            await self.__run_direct()
+
+    async def _find_accepted_delays(self) -> np.ndarray:
+        args: DelaysFinderParameters = await self._args
+        prepared_args = await self._prepared_args
+        task = await self._task
+
+        gpu_signals: GPUArray = prepared_args[0]
+        gpu_accepted_count: GPUArray = prepared_args[-2]
+        processing_signal_length = args.signals_length - args.buffer
+        chunk_length = args.chunk_signals_length - args.buffer
+
+        # chunks overlap by buffer, so every time index of a chunk sees
+        # the same signals as in a single run over the whole signals
+        accepted_delays = [
+            np.zeros(shape=(0, args.stations_count + 1), dtype=np.int32)
+        ]
+        for start_time_index in range(
+                0, processing_signal_length, chunk_length
+        ):
+            if start_time_index > 0:
+                await gpu_signals.set_to_gpu(
+                    cl_queue=task.gpu_card.cl_queue,
+                    src=self.__get_chunk_signals(
+                        args=args,
+                        start_time_index=start_time_index
+                    )
+                )
+                await gpu_accepted_count.set_to_gpu(
+                    cl_queue=task.gpu_card.cl_queue,
+                    src=np.zeros(shape=1, dtype=np.int32)
+                )
+
+            await self.__run_engine()
+            chunk_accepted_delays = await self._compact_solution(
+                processing_signal_length=min(
+                    chunk_length, processing_signal_length - start_time_index
+                )
+            )
+            chunk_accepted_delays[:, 0] += start_time_index
+            accepted_delays.append(chunk_accepted_delays)
+
+        return np.concatenate(accepted_delays)
+
+    @staticmethod
+    def __get_partition_args(
+            args: DelaysFinderParameters,
+            start_time_index: int,
+            partition_length: int
+    ) -> DelaysFinderParameters:
+        end_time_index = min(
+            start_time_index + partition_length + args.buffer,
+            args.signals_length
+        )
+        signals = np.ascontiguousarray(
+            args.signals.convert_to_numpy_format()[
+                :, start_time_index:end_time_index
+            ]
+        )
+        return args.copy(
+            update={
+                'signals': Array(
+                    type_=args.signals.type_,
+                    shape=ArraySize(
+                        rows_count=args.stations_count,
+                        cols_count=signals.shape[1]
+                    ),
+                    data=signals.tobytes()
+                ),
+                'gpu_cards_count': 1
+            }
+        )
+
+    async def _is_partitioned(self) -> bool:
+        args: DelaysFinderParameters = await self._args
+        return args.gpu_cards_count != 1
+
+    @property
+    async def _args_bytes_size(self) -> int:
+        if await self._is_partitioned():
+            # partitions hold their own buffers on their cards, the card of
+            # the task only selects distinct delays
+            return 0
+        return await super()._args_bytes_size
+
+    @classmethod
+    def __get_partition_bytes_size(
+            cls,
+            args: DelaysFinderParameters,
+            partition_length: int
+    ) -> int:
+        # prepared args of the first partition are counted without building
+        # them, the other partitions are not longer
+        signals_length = min(
+            partition_length + args.buffer, args.signals_length
+        )
+        if args.chunk_length == 0:
+            chunk_signals_length = signals_length
+        else:
+            chunk_signals_length = min(
+                signals_length, args.chunk_length + args.buffer
+            )
+        processing_signal_length = chunk_signals_length - args.buffer
+        stations_count = args.stations_count
+        item_size = np.dtype(np.int32).itemsize
+
+        bytes_size = sum(
+            sys.getsizeof(arg) for arg in (
+                int(chunk_signals_length),
+                int(stations_count),
+                int(args.scanner_size),
+                int(args.window_size),
+                float(args.min_correlation),
+                int(args.base_station_index)
+            )
+        )
+        signals_item_size = np.dtype(args.signals.dtype).itemsize
+        bytes_size += stations_count * chunk_signals_length * signals_item_size
+        bytes_size += (
+            processing_signal_length * (stations_count + 1) * item_size
+        )
+        if args.engine == DelaysFinderEngine.RUNNING_SUM.value:
+            block_length = cls.__get_correlations_block_length(
+                args=args, processing_signal_length=processing_signal_length
+            )
+            bytes_size += (
+                block_length * stations_count * args.scanner_size * item_size
+            )
+        elif args.engine == DelaysFinderEngine.FFT.value:
+            block_length = cls.__get_spectra_block_length(
+                args=args, processing_signal_length=processing_signal_length
+            )
+            fft_size = cls.__get_fft_size(args=args)
+            bytes_size += (
+                2 * block_length * stations_count * fft_size * 2 * item_size
+            )
+        else:
+            segments_count = ceil(
+                chunk_signals_length / REPEATS_SEGMENT_LENGTH
+            )
+            repeats_length = chunk_signals_length + segments_count
+            bytes_size += stations_count * repeats_length * item_size
+        accepted_rows_count = min(
+            processing_signal_length, ACCEPTED_DELAYS_CAPACITY
+        )
+        accepted_count = 1 + accepted_rows_count * (stations_count + 1)
+        bytes_size += accepted_count * item_size
+        return bytes_size
+
+    async def __get_partition_gpu_cards(
+            self,
+            processing_signal_length: int
+    ) -> Tuple[int, List[GPUCard]]:
+        args: DelaysFinderParameters = await self._args
+        gpu_rig = GPURig()
+
+        # time indexes are split before choosing cards, so every card has
+        # to hold its own partition only. Fewer free cards get longer
+        # partitions, which are checked again
+        cards_count = args.gpu_cards_count or len(gpu_rig.gpu_cards)
+        while True:
+            partition_length = ceil(processing_signal_length / cards_count)
+            gpu_cards = gpu_rig.get_free_gpu_cards(
+                required_memory_size=self.__get_partition_bytes_size(
+                    args=args, partition_length=partition_length
+                ),
+                max_cards_count=cards_count
+            )
+            if len(gpu_cards) == cards_count:
+                return partition_length, gpu_cards
+            cards_count = len(gpu_cards)
 
-        gpu_solution: GPUArray = prepared_args[-1]
-        self._solution = await gpu_solution.get_from_gpu(
-            cl_queue=task.gpu_card.cl_queue
+    async def __find_partitioned_accepted_delays(self) -> np.ndarray:
+        args: DelaysFinderParameters = await self._args
+
+        # partitions overlap by buffer like chunks of a single card
+        processing_signal_length = args.signals_length - args.buffer
+        partition_length, gpu_cards = await self.__get_partition_gpu_cards(
+            processing_signal_length=processing_signal_length
         )
+        start_time_indexes = range(
+            0, processing_signal_length, partition_length
+        )
+        partitions = [
+            DelaysFinderPartition(
+                task_id=await self.task_id,
+                redis_storage=self.redis_storage,
+                file_storage=self.file_storage,
+                args=self.__get_partition_args(
+                    args=args,
+                    start_time_index=start_time_index,
+                    partition_length=partition_length
+                ),
+                gpu_card=gpu_card
+            ) for start_time_index, gpu_card in zip(
+                start_time_indexes, gpu_cards
+            )
+        ]
+        await self.add_log_message(
+            text=f'Time indexes are shared by {len(partitions)} GPU cards'
+        )
+
+        loop = asyncio.get_running_loop()
+        with ThreadPoolExecutor(max_workers=len(partitions)) as executor:
+            partitions_accepted_delays = await asyncio.gather(
+                *[
+                    loop.run_in_executor(
+                        executor, partition.find_accepted_delays
+                    ) for partition in partitions
+                ]
+            )
+
+        for partition in partitions:
+            for text in partition.log_messages:
+                await self.add_log_message(text=text)
+
+        for start_time_index, accepted_delays in zip(
+                start_time_indexes, partitions_accepted_delays
+        ):
+            accepted_delays[:, 0] += start_time_index
+        return np.concatenate(partitions_accepted_delays)
+
+    async def _run(self):
+        await self.add_log_message(text='Finding real delays starting ...')
+        if not await self._is_partitioned():
+            self._solution = await self._find_accepted_delays()
+        else:
+            self._solution = await self.__find_partitioned_accepted_delays()
+
+        await self._select_distinct_delays()
         await self.add_log_message(
             text='Real delays array was extract successfully'
         )
@@ -128,48 +980,59 @@ class DelaysFinder(GPUProcess):
         Returns: np.ndarray
 
         """
-        additional_columns = np.zeros(
-            shape=(self._solution.shape[0], 2),
-            dtype=np.int32
-        )
-        additional_columns[:, 0] = np.arange(
-            0, self._solution.shape[0], 1
+        return self._solution
+
+
+class DelaysFinderPartition(DelaysFinder):
+    """Part of delays finder task running on the given GPU card.
+
+    Partition is run in its own thread, so log messages are collected
+    and saved by the whole task later.
+
+    """
+
+    def __init__(
+            self,
+            task_id: str,
+            redis_storage: RedisStorage,
+            file_storage: FileStorage,
+            args: DelaysFinderParameters,
+            gpu_card: GPUCard
+    ):
+        super().__init__(
+            task_id=task_id,
+            redis_storage=redis_storage,
+            file_storage=file_storage
         )
-        processing_parameters: DelaysFinderParameters = await self._args
-        additional_columns[:, 1] = processing_parameters.window_size
 
-        solution = np.column_stack((additional_columns, self._solution))
-        solution = solution[solution[:, 2] == 1]
-        solution = np.delete(solution, 2, 1)
+        self.__args = args
+        self.__gpu_card = gpu_card
+        self.log_messages: List[str] = []
 
-        skipped_indexes, selected_indexes = set(), []
+    async def _load_args_from_file(self) -> DelaysFinderParameters:
+        return self.__args
 
-        for i in range(solution.shape[0]):
-            if i in skipped_indexes:
-                continue
+    async def _create_task(self) -> GPUTask:
+        return GPUTask(
+            gpu_card=self.__gpu_card,
+            core=self._get_kernel_core(kernel_filename=KERNEL_FILENAME),
+            definitions=self._get_kernel_definitions(args=self.__args),
+            program_cache=self.program_cache
+        )
 
-            selected_indexes.append(i)
-            row_a = solution[i, 2:]
-            max_j_index = min(
-                i + processing_parameters.scanner_size + 1, solution.shape[0]
-            )
-            duration_index = i
-            for j in range(i + 1, max_j_index):
-                if j in skipped_indexes:
-                    continue
+    async def add_log_message(self, text: str):
+        self.log_messages.append(text)
 
-                row_b = solution[j, 2:]
-                similarity_coeff = get_similarity_coeff(
-                    row_a=row_a,
-                    row_b=row_b,
-                    time_epsilon=TIME_EPSILON
-                )
-                if similarity_coeff >= SIMILARITY_COEFFICIENT:
-                    skipped_indexes.add(j)
-                    duration_index = j
+    async def __find_accepted_delays(self) -> np.ndarray:
+        try:
+            return await self._find_accepted_delays()
+        finally:
+            await self._release_args()
 
-            solution[i, 1] = (
-                duration_index - i + processing_parameters.window_size
-            )
-        solution = solution[selected_indexes]
-        return solution
+    def find_accepted_delays(self) -> np.ndarray:
+        """Return accepted delays rows of partition signals.
+
+        Returns: np.ndarray
+
+        """
+        return asyncio.run(self.__find_accepted_delays())
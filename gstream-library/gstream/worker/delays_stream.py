@@ -0,0 +1,289 @@
+import asyncio
+import struct
+import time
+from math import ceil
+from typing import List
+
+import numpy as np
+
+from gstream.models import Array, DelaysFinderParameters
+from gstream.node.gpu_task import GPUArray
+from gstream.storage.file_system import Storage as FileStorage
+from gstream.storage.redis import Storage as RedisStorage
+from gstream.worker.delays_finder import REPEATS_SEGMENT_LENGTH, DelaysFinder
+
+RING_APPEND_FUNCTION_NAME = 'append_ring_samples'
+RING_DELAYS_FUNCTION_NAME = 'get_ring_delays'
+STREAM_BLOCK_LENGTH = 65536
+STREAM_POLL_SECONDS = 0.05
+
+
+class DelaysStreamFinder(DelaysFinder):
+    """Delays finder over signals appended while the task is running.
+
+    Signals are kept in a ring buffer on GPU card, and only time indexes
+    which became computable after an appended block are processed. Their
+    accepted delays are appended to the detections file at once. Empty
+    block closes the stream, then similar delays are merged into the
+    output file like in DelaysFinder.
+
+    """
+
+    def __init__(
+            self,
+            task_id: str,
+            redis_storage: RedisStorage,
+            file_storage: FileStorage
+    ):
+        super().__init__(
+            task_id=task_id,
+            redis_storage=redis_storage,
+            file_storage=file_storage
+        )
+
+        self.__stream_offset = 0
+        self.__samples_count = 0
+        self.__accepted_delays: List[np.ndarray] = []
+
+    async def _prepare_args(self):
+        args: DelaysFinderParameters = await self._args
+        stations_count = args.stations_count
+
+        # block of samples and the windows it completes fit into ring
+        ring_length = STREAM_BLOCK_LENGTH + args.buffer
+        result_array = np.zeros(
+            shape=(STREAM_BLOCK_LENGTH, stations_count + 1),
+            dtype=np.int32
+        )
+
+        return [
+            GPUArray(
+                src=np.zeros(
+                    shape=(stations_count, 2 * ring_length),
+                    dtype=np.float32
+                ),
+                is_copy=True,
+                is_read_write=True
+            ),
+            int(ring_length),
+            int(stations_count),
+            int(args.scanner_size),
+            int(args.window_size),
+            float(args.min_correlation),
+            int(args.base_station_index),
+            GPUArray(src=result_array, is_read_write=True),
+            GPUArray(
+                src=np.zeros(
+                    shape=(stations_count, 2 * ring_length),
+                    dtype=np.int32
+                ),
+                is_read_write=True
+            ),
+            GPUArray(
+                src=np.zeros(
+                    shape=(
+                        stations_count,
+                        ceil(2 * ring_length / REPEATS_SEGMENT_LENGTH)
+                    ),
+                    dtype=np.int32
+                ),
+                is_read_write=True
+            ),
+            # samples of a block are packed by its length, only their
+            # leading part is copied
+            GPUArray(
+                src=np.zeros(
+                    shape=stations_count * STREAM_BLOCK_LENGTH,
+                    dtype=np.float32
+                ),
+                is_copy=True
+            ),
+            GPUArray(
+                src=np.zeros(shape=1, dtype=np.int32),
+                is_copy=True,
+                is_read_write=True
+            ),
+            GPUArray(
+                src=self._get_accepted_delays_array(
+                    rows_count=STREAM_BLOCK_LENGTH,
+                    stations_count=stations_count
+                )
+            )
+        ]
+
+    async def _is_partitioned(self) -> bool:
+        # stream blocks are processed on the card of the task
+        return False
+
+    async def __read_stream_blocks(self) -> List[Array]:
+        state = await self.task_state
+        if not self.file_storage.is_file_exist(
+                filename=state.stream_filename
+        ):
+            return []
+
+        bytes_obj = await self.file_storage.get_binary_data_from_file(
+            filename=state.stream_filename,
+            offset=self.__stream_offset
+        )
+
+        blocks = []
+        while bytes_obj:
+            try:
+                block = Array.create_from_bytes(bytes_obj=bytes_obj)
+            except (TypeError, ValueError, struct.error):
+                # the last block is not fully written yet
+                break
+
+            bytes_obj = bytes_obj[block.bytes_size:]
+            self.__stream_offset += block.bytes_size
+            blocks.append(block)
+        return blocks
+
+    async def __emit_detections(self, accepted_delays: np.ndarray):
+        if accepted_delays.shape[0] == 0:
+            return
+
+        self.__accepted_delays.append(accepted_delays)
+
+        args: DelaysFinderParameters = await self._args
+        state = await self.task_state
+        detections = np.insert(accepted_delays, 1, args.window_size, axis=1)
+        await self.file_storage.append_binary_data(
+            data=Array.create_from_numpy_array(
+                arr=detections
+            ).convert_to_bytes(),
+            filename=state.detections_filename
+        )
+
+    async def __process_samples(self, samples: np.ndarray):
+        (
+            gpu_ring, ring_length, stations_count, scanner_size,
+            window_size, min_correlation, base_station_index, gpu_solution,
+            gpu_repeats_prefix, gpu_segments_repeats, gpu_samples,
+            gpu_accepted_count, _
+        ) = await self._prepared_args
+        task = await self._task
+
+        args: DelaysFinderParameters = await self._args
+        if samples.shape[0] != stations_count:
+            raise ValueError('Invalid stations count of stream block')
+
+        for first_sample_index in range(
+                0, samples.shape[1], STREAM_BLOCK_LENGTH
+        ):
+            block = samples[
+                :, first_sample_index:first_sample_index + STREAM_BLOCK_LENGTH
+            ]
+            samples_count = block.shape[1]
+            await gpu_samples.set_to_gpu(
+                cl_queue=task.gpu_card.cl_queue,
+                src=np.ascontiguousarray(block, dtype=np.float32).ravel(),
+                rows_count=stations_count * samples_count
+            )
+            await task.run(
+                function_name=RING_APPEND_FUNCTION_NAME,
+                args=[
+                    gpu_samples,
+                    samples_count,
+                    samples_count,
+                    stations_count,
+                    ring_length,
+                    self.__samples_count % ring_length,
+                    gpu_ring
+                ],
+                global_size=(stations_count * samples_count,)
+            )
+
+            first_time_index = max(0, self.__samples_count - args.buffer)
+            self.__samples_count += samples_count
+            times_count = self.__samples_count - args.buffer - first_time_index
+            if times_count <= 0:
+                continue
+
+            # rows read the last samples from the first ring index, which
+            # are contiguous in the mirrored ring
+            first_ring_index = first_time_index % ring_length
+            await self._run_repeats_prefix(
+                gpu_signals=gpu_ring,
+                signals_length=2 * ring_length,
+                stations_count=stations_count,
+                gpu_repeats_prefix=gpu_repeats_prefix,
+                gpu_segments_repeats=gpu_segments_repeats,
+                first_index=first_ring_index,
+                last_index=(
+                    first_ring_index + self.__samples_count - first_time_index
+                )
+            )
+            await task.run(
+                function_name=RING_DELAYS_FUNCTION_NAME,
+                args=[
+                    gpu_ring,
+                    gpu_repeats_prefix,
+                    ring_length,
+                    stations_count,
+                    scanner_size,
+                    window_size,
+                    min_correlation,
+                    base_station_index,
+                    first_ring_index,
+                    times_count,
+                    gpu_solution
+                ],
+                global_size=(times_count,)
+            )
+
+            await gpu_accepted_count.set_to_gpu(
+                cl_queue=task.gpu_card.cl_queue,
+                src=np.zeros(shape=1, dtype=np.int32)
+            )
+            accepted_delays = await self._compact_solution(
+                processing_signal_length=times_count
+            )
+            accepted_delays[:, 0] += first_time_index
+            await self.__emit_detections(accepted_delays=accepted_delays)
+
+    async def _run(self):
+        await self.add_log_message(text='Delays stream starting ...')
+        args: DelaysFinderParameters = await self._args
+        if args.signals_length > 0:
+            await self.__process_samples(
+                samples=args.signals.convert_to_numpy_format()
+            )
+
+        # a client which never closes the stream must not hold the card
+        last_block_time = time.monotonic()
+        is_stream_closed = False
+        while not is_stream_closed:
+            blocks = await self.__read_stream_blocks()
+            if not blocks:
+                idle_seconds = time.monotonic() - last_block_time
+                if 0 < args.stream_timeout < idle_seconds:
+                    await self.add_log_message(
+                        text=f'Delays stream has no blocks for '
+                             f'{args.stream_timeout} seconds'
+                    )
+                    break
+                await asyncio.sleep(STREAM_POLL_SECONDS)
+
+            for block in blocks:
+                if block.shape.cols_count == 0:
+                    is_stream_closed = True
+                    break
+
+                await self.__process_samples(
+                    samples=block.convert_to_numpy_format()
+                )
+                last_block_time = time.monotonic()
+        await self.add_log_message(text='Delays stream was closed')
+
+        self._solution = np.concatenate(
+            [
+                np.zeros(shape=(0, args.stations_count + 1), dtype=np.int32)
+            ] + self.__accepted_delays
+        )
+        await self._select_distinct_delays()
+        await self.add_log_message(
+            text='Real delays array was extract successfully'
+        )
+        await self._release_args()
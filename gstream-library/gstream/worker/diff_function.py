@@ -1,9 +1,13 @@
-from math import inf as INF
-from typing import List, Tuple, Union
+from math import ceil
+from pathlib import Path
+from typing import List, Optional, Tuple, Union
 
 import numpy as np
+import pyopencl as cl
 
-from gstream.models import DiffFunctionParameters
+from gstream.core_models import SeismicModel, Spacing, Stepping
+from gstream.files.writers import DiffFunctionResultBinaryFile
+from gstream.models import Array, DiffFunctionParameters
 from gstream.node.gpu_task import GPUArray, GPUTask
 from gstream.storage.file_system import Storage as FileStorage
 from gstream.storage.redis import Storage as RedisStorage
@@ -11,9 +15,59 @@ from gstream.worker.base import GPUProcess
 
 KERNEL_FILENAME = 'diff_function.c'
 FUNCTION_NAME = 'get_diff_function_cube'
+COLUMNS_FUNCTION_NAME = 'get_diff_function_columns'
+COLUMNS_GROUP_SIZE = 256
+PRUNED_FUNCTION_NAME = 'get_pruned_diff_function_cube'
+TABLE_FUNCTION_NAME = 'get_travel_times_table'
+TABLE_CUBE_FUNCTION_NAME = 'get_table_diff_function_cube'
+RAY_PARAMETERS_FUNCTION_NAME = 'get_ray_parameter_tables'
+RAY_PARAMETERS_CUBE_FUNCTION_NAME = 'get_ray_parameter_diff_function_cube'
+LATTICE_FUNCTION_NAME = 'get_lattice_travel_times'
+LATTICE_CUBE_FUNCTION_NAME = 'get_lattice_diff_function_cube'
+MISFITS_FUNCTION_NAME = 'get_lattice_misfits'
+MISFITS_TILE_SIZE = 16
+MISFITS_GROUP_SIZE = 64
+MISFITS_EVENTS_COUNT = 8
+BEST_NODES_FUNCTION_NAME = 'reduce_best_nodes'
+MERGE_BEST_NODES_FUNCTION_NAME = 'merge_best_nodes'
+# sub-cube spans one coarse step around the node on each side
+REFINEMENT_RADIUS = 2
+MINIMAL_NODES_FUNCTION_NAME = 'reduce_minimal_nodes'
+FUSED_MINIMAL_NODES_FUNCTION_NAME = 'get_diff_function_minimal_nodes'
+TABLE_MINIMAL_NODES_FUNCTION_NAME = 'get_table_diff_function_minimal_nodes'
+MERGE_MINIMAL_NODES_FUNCTION_NAME = 'merge_minimal_nodes'
+MINIMAL_NODES_GROUP_SIZE = 256
+# work-groups of all events fill compute units several times over
+MINIMAL_NODES_GROUPS_PER_COMPUTE_UNIT = 8
+# nodes of every work-item are bounded to keep kernels short
+MINIMAL_NODES_PER_WORK_ITEM = 16
+BEST_VALUES_FUNCTION_NAME = 'get_best_nodes_values'
+ELLIPSOIDS_FUNCTION_NAME = 'get_misfit_ellipsoids'
+ELLIPSOID_COLUMNS_COUNT = 10
+CUBE_ARGS_COUNT = 18
 EMPTY_ID, NULL_VALUE = -1, -9999
 
 
+def get_kernel_model(seismic_model: SeismicModel) -> np.ndarray:
+    """Return seismic model in the format of kernels.
+
+    Args:
+        seismic_model: seismic model
+
+    Returns: array (layers count x 6) of constant rows of (bottom, top, vp,
+        thickness, 1 / vp, vertical time from the model top to the layer
+        top)
+
+    """
+    model = seismic_model.convert_to_numpy_format()
+    thickness = model[:, 1] - model[:, 0]
+    slowness = 1 / model[:, 2]
+    vertical_times = np.cumsum(thickness * slowness) - thickness * slowness
+    return np.column_stack(
+        (model, thickness, slowness, vertical_times)
+    ).astype(np.float32)
+
+
 class SolutionColumn:
     x = 0
     y = 1
@@ -37,43 +91,186 @@ class DiffFunction(GPUProcess):
             file_storage=file_storage
         )
         self.__args = parameters
+        self.__lattice_nodes_count = self.__get_lattice_nodes_count()
+        self.__search_origins = self.__get_search_origins()
+        self.__refined_solution: Optional[np.ndarray] = None
+        self.__minimal_nodes: Tuple[np.ndarray, np.ndarray] = (
+            np.array([], dtype=np.int32),
+            np.array([], dtype=np.float32)
+        )
+        self.__best_nodes: Optional[np.ndarray] = None
+        self.__misfit_ellipsoids: Optional[np.ndarray] = None
 
     @property
     async def _args(self) -> DiffFunctionParameters:
         return self.__args
 
+    def __get_real_delays(self) -> np.ndarray:
+        # rows are (time, duration, delays...), kernels read only delays
+        return np.ascontiguousarray(
+            self.__args.real_delays[:, 2:], dtype=np.int32
+        )
+
+    def __is_cube_fused(self) -> bool:
+        input_args = self.__args
+        # the other options need stored cubes or have no fused kernel, they
+        # are rejected by parameters
+        return input_args.fused_minimum and not any((
+            self.__is_lattice_shared(),
+            input_args.travel_times_step == 0 and (
+                input_args.ray_parameters_count > 0
+            ),
+            input_args.refinement_step > 0,
+            input_args.best_nodes_count > 0,
+            input_args.misfit_threshold > 0
+        ))
+
+    def __is_cube_pruned(self) -> bool:
+        input_args = self.__args
+        # the other options need exact values of all nodes, they are
+        # rejected by parameters
+        return input_args.pruned_nodes and not any((
+            input_args.refinement_step > 0,
+            input_args.best_nodes_count > 0,
+            input_args.misfit_threshold > 0
+        ))
+
+    def __is_lattice_shared(self) -> bool:
+        input_args = self.__args
+        # lattice of scattered events outgrows their cubes, the events are
+        # evaluated by own cubes then
+        cubes_nodes_count = (
+            input_args.events_count * input_args.spacing.nodes_count
+        )
+        return input_args.shared_lattice and (
+            self.__lattice_nodes_count <= cubes_nodes_count
+        )
+
+    def __get_cube_mode(self) -> str:
+        input_args = self.__args
+        if self.__is_lattice_shared():
+            if input_args.batched_misfits:
+                return 'shared lattice with batched misfits'
+            return 'shared lattice'
+
+        if input_args.travel_times_step > 0:
+            mode = 'travel times table'
+        elif input_args.ray_parameters_count > 0:
+            mode = 'ray parameter tables'
+        elif input_args.column_nodes:
+            mode = 'rays per node columns'
+        elif self.__is_cube_pruned():
+            mode = 'pruned rays per node'
+        else:
+            mode = 'rays per node'
+
+        if self.__is_cube_fused():
+            mode += ' with fused minimum'
+        return mode
+
+    def __get_steps(self) -> np.ndarray:
+        input_args = self.__args
+        stepping = input_args.search_space.get_stepping(
+            spacing=input_args.spacing
+        )
+        return np.array([stepping.dx, stepping.dy, stepping.dz])
+
+    def __get_cube_origins(self) -> np.ndarray:
+        input_args = self.__args
+        spacing = np.array(input_args.spacing.format_to_list())
+        half_sizes = spacing * self.__get_steps() / 2
+        return input_args.search_space_centers - half_sizes
+
+    def __get_lattice(
+            self,
+            search_origins: np.ndarray
+    ) -> Tuple[np.ndarray, np.ndarray, np.ndarray]:
+        # cubes are snapped to the lattice started from the lowest origin
+        lattice_origin = search_origins.min(axis=0)
+        lattice_offsets = np.round(
+            (search_origins - lattice_origin) / self.__get_steps()
+        ).astype(np.int32)
+        lattice_shape = (
+            lattice_offsets.max(axis=0) + self.__args.spacing.format_to_list()
+        )
+        return lattice_origin, lattice_offsets, lattice_shape
+
+    def __get_lattice_nodes_count(self) -> int:
+        if not self.__args.shared_lattice:
+            return 0
+
+        _, _, lattice_shape = self.__get_lattice(
+            search_origins=self.__get_cube_origins()
+        )
+        return int(np.prod(lattice_shape, dtype=np.int64))
+
+    def __get_search_origins(self) -> np.ndarray:
+        search_origins = self.__get_cube_origins()
+        if not self.__is_lattice_shared():
+            return search_origins
+
+        lattice_origin, lattice_offsets, _ = self.__get_lattice(
+            search_origins=search_origins
+        )
+        return lattice_origin + lattice_offsets * self.__get_steps()
+
+    def __get_lattice_args(
+            self,
+            station_coordinates: np.ndarray
+    ) -> List[Union[int, float, GPUArray]]:
+        lattice_origin, lattice_offsets, lattice_shape = self.__get_lattice(
+            search_origins=self.__search_origins
+        )
+        lattice_nx, lattice_ny, lattice_nz = lattice_shape
+
+        lattice_times_gpu = GPUArray(
+            src=np.zeros(
+                shape=(
+                    lattice_nx * lattice_ny * lattice_nz,
+                    station_coordinates.shape[0]
+                ),
+                dtype=np.int32
+            ),
+            is_read_write=True
+        )
+        lattice_args = [
+            lattice_times_gpu,
+            float(lattice_origin[0]),
+            float(lattice_origin[1]),
+            float(lattice_origin[2]),
+            int(lattice_nx),
+            int(lattice_ny),
+            int(lattice_nz),
+            GPUArray(src=lattice_offsets, is_copy=True)
+        ]
+        return lattice_args
+
     async def _prepare_args(self) -> List[Union[int, float, GPUArray]]:
         input_args: DiffFunctionParameters = await self._args
 
         seismic_model_gpu = GPUArray(
-            src=input_args.seismic_model.convert_to_numpy_format(),
+            src=get_kernel_model(seismic_model=self.__args.seismic_model),
             is_copy=True
         )
 
         real_delays_gpu = GPUArray(
-            src=input_args.real_delays.astype(np.int32),
+            src=self.__get_real_delays(),
             is_copy=True
         )
 
+        # kernel reads (x, y) pairs, station number and altitude are skipped
+        station_coordinates = np.ascontiguousarray(
+            input_args.observation_system.convert_to_numpy_format()[:, 1:3]
+        )
         station_coordinates_gpu = GPUArray(
-            src=input_args.observation_system.convert_to_numpy_format(),
+            src=station_coordinates,
             is_copy=True
         )
 
         stepping = input_args.search_space.get_stepping(
             spacing=input_args.spacing
         )
-        offsets = np.array(
-            [
-                [
-                    -input_args.spacing.nx * stepping.dx / 2,
-                    -input_args.spacing.ny * stepping.dy / 2,
-                    -input_args.spacing.nz * stepping.dz / 2,
-                ]
-            ] * input_args.events_count,
-            dtype=np.float32
-        )
-        search_origins = input_args.search_space_centers + offsets
+        search_origins = self.__search_origins
 
         search_origins_gpu = GPUArray(
             src=search_origins.astype(np.float32),
@@ -83,6 +280,9 @@ class DiffFunction(GPUProcess):
         total_nodes_count = (
             input_args.spacing.nodes_count * input_args.events_count
         )
+        if self.__is_cube_fused():
+            # cube values are not stored by fused kernels
+            total_nodes_count = input_args.events_count
         error_cubes_nodes = np.zeros(
             shape=total_nodes_count,
             dtype=np.float32
@@ -117,19 +317,169 @@ class DiffFunction(GPUProcess):
             ),
             error_cubes_nodes_gpu
         ]
+        if self.__is_lattice_shared():
+            output_args += self.__get_lattice_args(
+                station_coordinates=station_coordinates
+            )
+        elif input_args.travel_times_step > 0:
+            output_args += self.__get_table_args(
+                search_origins=search_origins,
+                station_coordinates=station_coordinates
+            )
+        elif input_args.ray_parameters_count > 0:
+            output_args += self.__get_ray_parameter_args(
+                search_origins=search_origins
+            )
         return output_args
 
+    def __get_table_args(
+            self,
+            search_origins: np.ndarray,
+            station_coordinates: np.ndarray
+    ) -> List[Union[int, float, GPUArray]]:
+        input_args = self.__args
+        step = input_args.travel_times_step
+        stepping = input_args.search_space.get_stepping(
+            spacing=input_args.spacing
+        )
+        spacing = input_args.spacing
+
+        model_range = input_args.seismic_model.altitude_range
+        min_altitude = max(float(min(search_origins[:, 2])), model_range.min_)
+        max_altitude = min(
+            float(max(search_origins[:, 2])) + (spacing.nz - 1) * stepping.dz,
+            model_range.max_
+        )
+        altitudes_count = max(ceil((max_altitude - min_altitude) / step), 1)
+        # last altitude node must not leave the model
+        altitude_step = max(
+            max_altitude - min_altitude, step
+        ) / altitudes_count
+
+        # the farthest station from the bounding box of all nodes
+        min_x, min_y = min(search_origins[:, 0]), min(search_origins[:, 1])
+        max_x = max(search_origins[:, 0]) + (spacing.nx - 1) * stepping.dx
+        max_y = max(search_origins[:, 1]) + (spacing.ny - 1) * stepping.dy
+        max_offset = np.max(
+            np.hypot(
+                np.maximum(
+                    np.abs(station_coordinates[:, 0] - min_x),
+                    np.abs(station_coordinates[:, 0] - max_x)
+                ),
+                np.maximum(
+                    np.abs(station_coordinates[:, 1] - min_y),
+                    np.abs(station_coordinates[:, 1] - max_y)
+                )
+            )
+        )
+        offsets_count = max(ceil(max_offset / step), 1)
+
+        # one more node on each axis to cover the range edge
+        travel_times_gpu = GPUArray(
+            src=np.zeros(
+                shape=(altitudes_count + 1) * (offsets_count + 1),
+                dtype=np.float32
+            ),
+            is_read_write=True
+        )
+        return [
+            travel_times_gpu,
+            float(min_altitude),
+            float(altitude_step),
+            int(altitudes_count + 1),
+            float(step),
+            int(offsets_count + 1)
+        ]
+
+    def __get_ray_parameter_args(
+            self,
+            search_origins: np.ndarray
+    ) -> List[Union[int, float, GPUArray]]:
+        input_args = self.__args
+        stepping = input_args.search_space.get_stepping(
+            spacing=input_args.spacing
+        )
+        ray_parameters_count = input_args.ray_parameters_count
+
+        # one table row per distinct altitude of nodes of all cubes
+        node_altitudes = search_origins[:, 2:3] + stepping.dz * np.arange(
+            input_args.spacing.nz
+        )
+        source_altitudes, altitude_rows = np.unique(
+            node_altitudes.astype(np.float32), return_inverse=True
+        )
+        altitudes_count = source_altitudes.shape[0]
+        return [
+            GPUArray(src=source_altitudes, is_copy=True),
+            int(altitudes_count),
+            int(ray_parameters_count),
+            GPUArray(
+                src=np.zeros(
+                    shape=altitudes_count * ray_parameters_count,
+                    dtype=np.float32
+                ),
+                is_read_write=True
+            ),
+            GPUArray(
+                src=np.zeros(
+                    shape=altitudes_count * ray_parameters_count,
+                    dtype=np.float32
+                ),
+                is_read_write=True
+            ),
+            GPUArray(
+                src=altitude_rows.astype(np.int32),
+                is_copy=True
+            )
+        ]
+
     async def _create_task(self) -> GPUTask:
         await self.add_log_message(text='Creating GPU task...')
 
+        input_args: DiffFunctionParameters = await self._args
+        definitions = {
+            'RAY_SOLVER': input_args.ray_solver,
+            'LAYERS_COUNT': input_args.seismic_model.layers_count
+        }
+        if input_args.single_precision_rays:
+            definitions['SINGLE_PRECISION_RAYS'] = None
         task = GPUTask(
             gpu_card=await self.gpu_card,
-            core=self._get_kernel_core(kernel_filename=KERNEL_FILENAME)
+            core=self._get_kernel_core(kernel_filename=KERNEL_FILENAME),
+            definitions=definitions,
+            program_cache=self.program_cache
         )
 
         await self.add_log_message(text='GPU task was created')
         return task
 
+    async def _save_solution(self):
+        # best nodes (row of the event) and ellipsoids follow the solution,
+        # results which were not requested are written without rows
+        state = await self.task_state
+        input_args: DiffFunctionParameters = await self._args
+
+        arrays = [await self.solution]
+        if self.best_nodes is None:
+            arrays.append(np.zeros(shape=(0, 0)))
+        else:
+            arrays.append(
+                self.best_nodes.reshape(input_args.events_count, -1)
+            )
+        if self.misfit_ellipsoids is None:
+            arrays.append(np.zeros(shape=(0, 0)))
+        else:
+            arrays.append(self.misfit_ellipsoids)
+
+        writer = DiffFunctionResultBinaryFile(
+            path=Path(self.file_storage.root, state.output_args_filename),
+            data=[
+                Array.create_from_numpy_array(arr=arr.astype(np.float32))
+                for arr in arrays
+            ]
+        )
+        await writer.save()
+
     async def run(self):
         await self.add_log_message(
             text='Getting diff function cube starting ...'
@@ -137,51 +487,865 @@ class DiffFunction(GPUProcess):
 
         prepared_args = await self._prepared_args
         task = await self._task
+        input_args: DiffFunctionParameters = await self._args
+        is_cube_fused = self.__is_cube_fused()
+        if input_args.shared_lattice and not self.__is_lattice_shared():
+            cubes_nodes_count = (
+                input_args.events_count * input_args.spacing.nodes_count
+            )
+            await self.add_log_message(
+                text=f'Shared lattice of {self.__lattice_nodes_count} nodes '
+                     f'is larger than {cubes_nodes_count} nodes of event '
+                     f'cubes, it is not used'
+            )
+        await self.add_log_message(
+            text=f'Diff function cube is evaluated by {self.__get_cube_mode()}'
+        )
+        if self.__is_lattice_shared():
+            await self.__run_lattice(prepared_args=prepared_args)
+        elif input_args.travel_times_step > 0:
+            await self.__run_table(prepared_args=prepared_args)
+        elif input_args.ray_parameters_count > 0:
+            await self.__run_ray_parameters(prepared_args=prepared_args)
+        elif is_cube_fused:
+            await self.__find_minimal_nodes(
+                function_name=FUSED_MINIMAL_NODES_FUNCTION_NAME,
+                args=prepared_args[:CUBE_ARGS_COUNT - 1]
+            )
+        elif input_args.column_nodes:
+            await self.__run_columns(prepared_args=prepared_args)
+        elif self.__is_cube_pruned():
+            await self.__run_pruned(prepared_args=prepared_args)
+        else:
+            await task.run(
+                function_name=FUNCTION_NAME,
+                args=prepared_args
+            )
+
+        gpu_solution: GPUArray = prepared_args[CUBE_ARGS_COUNT - 1]
+        if input_args.refinement_step > 0:
+            await self.__refine(gpu_values=gpu_solution)
+        if input_args.best_nodes_count > 0:
+            await self.__find_best_nodes(gpu_values=gpu_solution)
+        if input_args.misfit_threshold > 0:
+            await self.__find_misfit_ellipsoids(gpu_values=gpu_solution)
+
+        if self.__refined_solution is None and not is_cube_fused:
+            await self.__find_minimal_nodes(
+                function_name=MINIMAL_NODES_FUNCTION_NAME,
+                args=[
+                    gpu_solution,
+                    input_args.spacing.nodes_count,
+                    input_args.events_count
+                ]
+            )
+        await self._release_args()
+
+    async def __run_columns(
+            self,
+            prepared_args: List[Union[int, float, GPUArray]]
+    ):
+        input_args: DiffFunctionParameters = await self._args
+        stations_count = input_args.observation_system.stations_count
+        task = await self._task
+        # cubes are taken from arguments to evaluate refinement sub-cubes
+        events_count = prepared_args[4]
+        spacing = Spacing(
+            nx=prepared_args[11],
+            ny=prepared_args[12],
+            nz=prepared_args[13]
+        )
+
+        # work-group holds offsets of its columns in local memory
+        offsets_size = stations_count * np.dtype(np.float32).itemsize
+        max_block_size = min(COLUMNS_GROUP_SIZE, task.gpu_card.max_block_size)
+        depths_count = min(spacing.nz, max_block_size)
+        columns_count = min(
+            max_block_size // depths_count,
+            task.gpu_card.local_memory_size // offsets_size
+        )
+        if columns_count == 0:
+            await task.run(
+                function_name=FUNCTION_NAME,
+                args=prepared_args,
+                global_size=(events_count * spacing.nodes_count,)
+            )
+            return
+
+        columns_groups_count = ceil(spacing.nx * spacing.ny / columns_count)
+        await task.run(
+            function_name=COLUMNS_FUNCTION_NAME,
+            args=[
+                *prepared_args[:CUBE_ARGS_COUNT - 1],
+                cl.LocalMemory(columns_count * offsets_size),
+                prepared_args[CUBE_ARGS_COUNT - 1]
+            ],
+            global_size=(
+                depths_count,
+                columns_groups_count * columns_count,
+                events_count
+            ),
+            local_size=(depths_count, columns_count, 1)
+        )
+
+    async def __run_pruned(
+            self,
+            prepared_args: List[Union[int, float, GPUArray]]
+    ):
+        input_args: DiffFunctionParameters = await self._args
+        task = await self._task
+
+        # bits of non-negative floats are ordered like integers, so best
+        # values are updated by integer atomic minimum
+        gpu_best_values = GPUArray(
+            src=np.full(
+                shape=input_args.events_count,
+                fill_value=np.inf,
+                dtype=np.float32
+            ).view(np.int32),
+            is_copy=True,
+            is_read_write=True
+        )
+        await task.run(
+            function_name=PRUNED_FUNCTION_NAME,
+            args=[
+                *prepared_args[:CUBE_ARGS_COUNT - 1],
+                gpu_best_values,
+                prepared_args[CUBE_ARGS_COUNT - 1]
+            ],
+            global_size=(
+                input_args.spacing.nodes_count * input_args.events_count,
+            )
+        )
+        gpu_best_values.release()
+
+    async def __run_table(
+            self,
+            prepared_args: List[Union[int, float, GPUArray]]
+    ):
+        (
+            gpu_model, layers_count, gpu_real_delays, stations_count,
+            events_count, gpu_station_coordinates, stations_altitude,
+            gpu_search_origins, dx, dy, dz, nx, ny, nz, accuracy, frequency,
+            base_station_index, gpu_solution
+        ) = prepared_args[:CUBE_ARGS_COUNT]
+        table_args = prepared_args[CUBE_ARGS_COUNT:]
+        _, _, _, altitudes_count, _, offsets_count = table_args
+        task = await self._task
+
         await task.run(
-            function_name=FUNCTION_NAME,
-            args=prepared_args
+            function_name=TABLE_FUNCTION_NAME,
+            args=[
+                gpu_model,
+                layers_count,
+                stations_altitude,
+                *table_args[1:],
+                accuracy,
+                frequency,
+                table_args[0]
+            ],
+            global_size=(altitudes_count * offsets_count,)
         )
+        await self.add_log_message(text='Travel times table was calculated')
+
+        cube_args = [
+            *table_args,
+            gpu_model,
+            layers_count,
+            gpu_real_delays,
+            stations_count,
+            events_count,
+            gpu_station_coordinates,
+            gpu_search_origins,
+            dx,
+            dy,
+            dz,
+            nx,
+            ny,
+            nz,
+            base_station_index
+        ]
+        if self.__is_cube_fused():
+            await self.__find_minimal_nodes(
+                function_name=TABLE_MINIMAL_NODES_FUNCTION_NAME,
+                args=cube_args
+            )
+            return
+
+        await task.run(
+            function_name=TABLE_CUBE_FUNCTION_NAME,
+            args=[*cube_args, gpu_solution],
+            global_size=(nx * ny * nz * events_count,)
+        )
+
+    async def __run_ray_parameters(
+            self,
+            prepared_args: List[Union[int, float, GPUArray]]
+    ):
+        (
+            gpu_model, layers_count, gpu_real_delays, stations_count,
+            events_count, gpu_station_coordinates, stations_altitude,
+            gpu_search_origins, dx, dy, dz, nx, ny, nz, accuracy, frequency,
+            base_station_index, gpu_solution
+        ) = prepared_args[:CUBE_ARGS_COUNT]
+        (
+            gpu_source_altitudes, altitudes_count, ray_parameters_count,
+            gpu_ray_offsets, gpu_ray_times, gpu_altitude_rows
+        ) = prepared_args[CUBE_ARGS_COUNT:]
+        task = await self._task
+
+        await task.run(
+            function_name=RAY_PARAMETERS_FUNCTION_NAME,
+            args=[
+                gpu_model,
+                layers_count,
+                stations_altitude,
+                gpu_source_altitudes,
+                altitudes_count,
+                ray_parameters_count,
+                frequency,
+                gpu_ray_offsets,
+                gpu_ray_times
+            ],
+            global_size=(altitudes_count * ray_parameters_count,)
+        )
+        await self.add_log_message(
+            text=f'Ray parameter tables were calculated for '
+                 f'{altitudes_count} altitudes'
+        )
+
+        await task.run(
+            function_name=RAY_PARAMETERS_CUBE_FUNCTION_NAME,
+            args=[
+                gpu_ray_offsets,
+                gpu_ray_times,
+                ray_parameters_count,
+                gpu_altitude_rows,
+                gpu_model,
+                layers_count,
+                gpu_real_delays,
+                stations_count,
+                events_count,
+                gpu_station_coordinates,
+                stations_altitude,
+                gpu_search_origins,
+                dx,
+                dy,
+                dz,
+                nx,
+                ny,
+                nz,
+                accuracy,
+                frequency,
+                base_station_index,
+                gpu_solution
+            ],
+            global_size=(nx * ny * nz * events_count,)
+        )
+
+    async def __run_lattice(
+            self,
+            prepared_args: List[Union[int, float, GPUArray]]
+    ):
+        (
+            gpu_model, layers_count, gpu_real_delays, stations_count,
+            events_count, gpu_station_coordinates, stations_altitude,
+            _, dx, dy, dz, nx, ny, nz, accuracy, frequency,
+            base_station_index, gpu_solution
+        ) = prepared_args[:CUBE_ARGS_COUNT]
+        (
+            gpu_lattice_times, lattice_x, lattice_y, lattice_altitude,
+            lattice_nx, lattice_ny, lattice_nz, gpu_lattice_offsets
+        ) = prepared_args[CUBE_ARGS_COUNT:]
+        task = await self._task
 
-        gpu_solution: GPUArray = prepared_args[-1]
-        self._solution = await gpu_solution.get_from_gpu(
+        lattice_nodes_count = lattice_nx * lattice_ny * lattice_nz
+        await task.run(
+            function_name=LATTICE_FUNCTION_NAME,
+            args=[
+                gpu_model,
+                layers_count,
+                gpu_station_coordinates,
+                stations_count,
+                stations_altitude,
+                lattice_x,
+                lattice_y,
+                lattice_altitude,
+                dx,
+                dy,
+                dz,
+                lattice_nx,
+                lattice_ny,
+                lattice_nz,
+                accuracy,
+                frequency,
+                gpu_lattice_times
+            ],
+            global_size=(lattice_nodes_count * stations_count,)
+        )
+        await self.add_log_message(
+            text=f'Travel times were calculated for {lattice_nodes_count} '
+                 f'lattice nodes'
+        )
+
+        input_args: DiffFunctionParameters = await self._args
+        if input_args.batched_misfits:
+            await self.__run_batched_misfits(
+                gpu_lattice_times=gpu_lattice_times,
+                lattice_shape=(lattice_nx, lattice_ny, lattice_nz),
+                gpu_lattice_offsets=gpu_lattice_offsets
+            )
+            return
+
+        await task.run(
+            function_name=LATTICE_CUBE_FUNCTION_NAME,
+            args=[
+                gpu_lattice_times,
+                lattice_nx,
+                lattice_ny,
+                gpu_lattice_offsets,
+                gpu_real_delays,
+                stations_count,
+                events_count,
+                nx,
+                ny,
+                nz,
+                base_station_index,
+                gpu_solution
+            ],
+            global_size=(nx * ny * nz * events_count,)
+        )
+
+    async def __run_batched_misfits(
+            self,
+            gpu_lattice_times: GPUArray,
+            lattice_shape: Tuple[int, int, int],
+            gpu_lattice_offsets: GPUArray
+    ):
+        prepared_args = await self._prepared_args
+        (
+            _, _, gpu_real_delays, stations_count, events_count, _, _, _,
+            _, _, _, nx, ny, nz, _, _, base_station_index, gpu_solution
+        ) = prepared_args[:CUBE_ARGS_COUNT]
+        task = await self._task
+
+        # work-groups stage rows of lattice node times padded by one item
+        # and delays of an events block, rows of all stations are kept if
+        # they fit, so node times are read once for all events
+        group_size = min(MISFITS_GROUP_SIZE, task.gpu_card.max_block_size)
+        item_size = np.dtype(np.int32).itemsize
+        rows_items_count = group_size * (stations_count + 1)
+        delays_items_count = MISFITS_EVENTS_COUNT * stations_count
+        local_items_count = rows_items_count + delays_items_count
+        tile_size = stations_count
+        if local_items_count * item_size > task.gpu_card.local_memory_size:
+            tile_size = MISFITS_TILE_SIZE
+        lattice_nodes_count = int(np.prod(lattice_shape))
+
+        await task.run(
+            function_name=MISFITS_FUNCTION_NAME,
+            args=[
+                gpu_lattice_times,
+                *lattice_shape,
+                gpu_lattice_offsets,
+                gpu_real_delays,
+                stations_count,
+                events_count,
+                nx,
+                ny,
+                nz,
+                base_station_index,
+                tile_size,
+                cl.LocalMemory(group_size * (tile_size + 1) * item_size),
+                cl.LocalMemory(MISFITS_EVENTS_COUNT * tile_size * item_size),
+                gpu_solution
+            ],
+            global_size=(
+                ceil(lattice_nodes_count / group_size) * group_size,
+            ),
+            local_size=(group_size,)
+        )
+
+    async def __get_best_nodes(
+            self,
+            gpu_values: GPUArray,
+            nodes_count: int,
+            best_nodes_count: int
+    ) -> np.ndarray:
+        # first stage keeps the best nodes of every work-group per event,
+        # second stage selects the best of them like minimal nodes
+        input_args: DiffFunctionParameters = await self._args
+        events_count = input_args.events_count
+        task = await self._task
+
+        group_size = self.__get_reduction_group_size(task=task)
+        groups_count = self.__get_reduction_groups_count(
+            task=task,
+            nodes_count=nodes_count,
+            group_size=group_size
+        )
+        partials_count = groups_count * best_nodes_count
+        local_args = [
+            cl.LocalMemory(group_size * np.dtype(np.float32).itemsize),
+            cl.LocalMemory(group_size * np.dtype(np.int32).itemsize)
+        ]
+
+        gpu_partial_values = GPUArray(
+            src=np.zeros(
+                shape=(events_count, partials_count),
+                dtype=np.float32
+            ),
+            is_read_write=True
+        )
+        gpu_partial_nodes = GPUArray(
+            src=np.zeros(shape=(events_count, partials_count), dtype=np.int32),
+            is_read_write=True
+        )
+        await task.run(
+            function_name=BEST_NODES_FUNCTION_NAME,
+            args=[
+                gpu_values,
+                nodes_count,
+                events_count,
+                best_nodes_count,
+                *local_args,
+                gpu_partial_values,
+                gpu_partial_nodes
+            ],
+            global_size=(groups_count * group_size, events_count),
+            local_size=(group_size, 1)
+        )
+
+        gpu_best_nodes = GPUArray(
+            src=np.zeros(
+                shape=(events_count, best_nodes_count),
+                dtype=np.int32
+            )
+        )
+        await task.run(
+            function_name=MERGE_BEST_NODES_FUNCTION_NAME,
+            args=[
+                gpu_partial_values,
+                gpu_partial_nodes,
+                partials_count,
+                events_count,
+                best_nodes_count,
+                *local_args,
+                gpu_best_nodes
+            ],
+            global_size=(group_size, events_count),
+            local_size=(group_size, 1)
+        )
+        best_nodes = await gpu_best_nodes.get_from_gpu(
+            cl_queue=task.gpu_card.cl_queue
+        )
+        for gpu_array in (
+                gpu_partial_values, gpu_partial_nodes, gpu_best_nodes
+        ):
+            gpu_array.release()
+        return best_nodes
+
+    @staticmethod
+    def __get_nodes_coordinates(
+            best_nodes: np.ndarray,
+            origins: np.ndarray,
+            spacing: Spacing,
+            stepping: Stepping
+    ) -> np.ndarray:
+        """Return coordinates of the best nodes of all events.
+
+        Args:
+            best_nodes: ids of nodes in cubes of the event (events x K)
+            origins: origins of cubes (events x cubes count x 3)
+            spacing: cube spacing
+            stepping: cube stepping
+
+        Returns: coordinates array (events x K x 3), NaN for missing nodes
+
+        """
+        coordinates = np.full(
+            shape=best_nodes.shape + (3,),
+            fill_value=np.nan
+        )
+        steps = np.array([stepping.dx, stepping.dy, stepping.dz])
+        for event_id, k in zip(*np.nonzero(best_nodes != NULL_VALUE)):
+            cube_id, node_id = divmod(
+                int(best_nodes[event_id, k]), spacing.nodes_count
+            )
+            coordinates[event_id, k] = origins[event_id, cube_id] + steps * (
+                spacing.get_node_id(node_id=node_id)
+            )
+        return coordinates
+
+    async def __refine(self, gpu_values: GPUArray):
+        input_args: DiffFunctionParameters = await self._args
+        prepared_args = await self._prepared_args
+        (
+            gpu_model, layers_count, _, stations_count, events_count,
+            gpu_station_coordinates, stations_altitude, _, _, _, _,
+            _, _, _, accuracy, frequency, base_station_index, _
+        ) = prepared_args[:CUBE_ARGS_COUNT]
+        task = await self._task
+
+        spacing = input_args.spacing
+        stepping = input_args.search_space.get_stepping(spacing=spacing)
+        if stepping.max_step <= input_args.refinement_step:
+            return
+
+        best_nodes_count = input_args.refinement_nodes_count
+        best_nodes = await self.__get_best_nodes(
+            gpu_values=gpu_values,
+            nodes_count=spacing.nodes_count,
+            best_nodes_count=best_nodes_count
+        )
+        coordinates = self.__get_nodes_coordinates(
+            best_nodes=best_nodes,
+            origins=self.__search_origins[:, None],
+            spacing=spacing,
+            stepping=stepping
+        )
+
+        # every best node of the event is a sub-cube processed like an
+        # event with the same delays
+        gpu_real_delays = GPUArray(
+            src=np.repeat(
+                self.__get_real_delays(), best_nodes_count, axis=0
+            ),
+            is_copy=True
+        )
+        sub_spacing = Spacing(
+            nx=2 * REFINEMENT_RADIUS + 1,
+            ny=2 * REFINEMENT_RADIUS + 1,
+            nz=2 * REFINEMENT_RADIUS + 1
+        )
+        sub_cubes_count = events_count * best_nodes_count
+        gpu_sub_values = GPUArray(
+            src=np.zeros(
+                shape=sub_cubes_count * sub_spacing.nodes_count,
+                dtype=np.float32
+            )
+        )
+
+        levels_count = 0
+        while stepping.max_step > input_args.refinement_step:
+            stepping = stepping.reduce()
+            steps = np.array([stepping.dx, stepping.dy, stepping.dz])
+
+            # missing nodes repeat the best one, so sub-cubes stay valid
+            centers = np.where(
+                np.isnan(coordinates), coordinates[:, :1], coordinates
+            )
+            centers = np.nan_to_num(centers)
+            origins = centers - REFINEMENT_RADIUS * steps
+            gpu_origins = GPUArray(
+                src=origins.reshape(-1, 3).astype(np.float32),
+                is_copy=True
+            )
+            sub_cubes_args = [
+                gpu_model,
+                layers_count,
+                gpu_real_delays,
+                stations_count,
+                sub_cubes_count,
+                gpu_station_coordinates,
+                stations_altitude,
+                gpu_origins,
+                float(stepping.dx),
+                float(stepping.dy),
+                float(stepping.dz),
+                sub_spacing.nx,
+                sub_spacing.ny,
+                sub_spacing.nz,
+                accuracy,
+                frequency,
+                base_station_index,
+                gpu_sub_values
+            ]
+            if input_args.column_nodes:
+                await self.__run_columns(prepared_args=sub_cubes_args)
+            else:
+                await task.run(
+                    function_name=FUNCTION_NAME,
+                    args=sub_cubes_args,
+                    global_size=(sub_cubes_count * sub_spacing.nodes_count,)
+                )
+            gpu_origins.release()
+
+            sub_best_nodes = await self.__get_best_nodes(
+                gpu_values=gpu_sub_values,
+                nodes_count=best_nodes_count * sub_spacing.nodes_count,
+                best_nodes_count=best_nodes_count
+            )
+            coordinates = np.where(
+                np.isnan(coordinates[:, :1]),
+                np.nan,
+                self.__get_nodes_coordinates(
+                    best_nodes=sub_best_nodes,
+                    origins=origins,
+                    spacing=sub_spacing,
+                    stepping=stepping
+                )
+            )
+            best_nodes = sub_best_nodes
+            levels_count += 1
+
+        values = (
+            await gpu_sub_values.get_from_gpu(cl_queue=task.gpu_card.cl_queue)
+        ).reshape(events_count, -1)
+        gpu_sub_values.release()
+        gpu_real_delays.release()
+
+        is_refined = np.logical_and(
+            best_nodes[:, 0] != NULL_VALUE,
+            ~np.isnan(coordinates[:, 0, 0])
+        )
+        node_ids = best_nodes[is_refined, 0].astype(np.int64)
+        refined_solution = np.column_stack((
+            coordinates[is_refined, 0],
+            values[is_refined, node_ids]
+        )).astype(np.float32)
+        self.__refined_solution = refined_solution
+        # sub-cubes are off the lattice and tables of the cube, so their
+        # rays are traced per node by the same solver
+        evaluator = 'node columns' if input_args.column_nodes else 'node'
+        await self.add_log_message(
+            text=f'Best nodes were refined in {levels_count} levels '
+                 f'up to step {stepping.max_step} by rays per {evaluator}'
+        )
+
+    @staticmethod
+    def __get_reduction_group_size(task: GPUTask) -> int:
+        # work-group reduction needs power of two group size
+        max_block_size = min(
+            MINIMAL_NODES_GROUP_SIZE, task.gpu_card.max_block_size
+        )
+        return 1 << (max_block_size.bit_length() - 1)
+
+    def __get_reduction_groups_count(
+            self,
+            task: GPUTask,
+            nodes_count: int,
+            group_size: int
+    ) -> int:
+        # work-groups of all events fill the device, and every work-item
+        # reduces a bounded count of nodes
+        device_groups_count = task.gpu_card.compute_units_count * (
+            MINIMAL_NODES_GROUPS_PER_COMPUTE_UNIT
+        )
+        return min(
+            ceil(nodes_count / group_size),
+            max(
+                ceil(device_groups_count / self.__args.events_count),
+                ceil(nodes_count / (group_size * MINIMAL_NODES_PER_WORK_ITEM))
+            )
+        )
+
+    async def __find_best_nodes(self, gpu_values: GPUArray):
+        input_args: DiffFunctionParameters = await self._args
+        events_count = input_args.events_count
+        best_nodes_count = input_args.best_nodes_count
+        spacing = input_args.spacing
+        task = await self._task
+
+        best_nodes = await self.__get_best_nodes(
+            gpu_values=gpu_values,
+            nodes_count=spacing.nodes_count,
+            best_nodes_count=best_nodes_count
+        )
+        gpu_best_nodes = GPUArray(src=best_nodes, is_copy=True)
+        gpu_best_values = GPUArray(
+            src=np.zeros(shape=best_nodes.shape, dtype=np.float32)
+        )
+        await task.run(
+            function_name=BEST_VALUES_FUNCTION_NAME,
+            args=[
+                gpu_values,
+                spacing.nodes_count,
+                events_count,
+                best_nodes_count,
+                gpu_best_nodes,
+                gpu_best_values
+            ],
+            global_size=(events_count * best_nodes_count,)
+        )
+        best_values = await gpu_best_values.get_from_gpu(
             cl_queue=task.gpu_card.cl_queue
         )
+        gpu_best_nodes.release()
+        gpu_best_values.release()
+
+        coordinates = self.__get_nodes_coordinates(
+            best_nodes=best_nodes,
+            origins=self.__search_origins[:, None],
+            spacing=spacing,
+            stepping=input_args.search_space.get_stepping(spacing=spacing)
+        )
+        self.__best_nodes = np.concatenate(
+            (coordinates, best_values[..., None]), axis=2
+        ).astype(np.float32)
         await self.add_log_message(
-            text='Diff function cube was extracted successfully'
+            text=f'{best_nodes_count} best nodes of events were found'
         )
-        await self._release_args()
 
-    async def __preprocess_solution(self) -> Tuple[np.ndarray, np.ndarray]:
+    async def __find_misfit_ellipsoids(self, gpu_values: GPUArray):
         input_args: DiffFunctionParameters = await self._args
+        events_count = input_args.events_count
+        (
+            _, _, _, _, _, _, _, gpu_search_origins, dx, dy, dz, nx, ny, nz,
+            _, _, _, _
+        ) = (await self._prepared_args)[:CUBE_ARGS_COUNT]
+        task = await self._task
 
-        node_ids = np.zeros(
-            shape=input_args.events_count,
-            dtype=np.int32
+        group_size = self.__get_reduction_group_size(task=task)
+        gpu_ellipsoids = GPUArray(
+            src=np.zeros(
+                shape=(events_count, ELLIPSOID_COLUMNS_COUNT),
+                dtype=np.float32
+            )
         )
-        diff_function_values = np.zeros(
-            shape=input_args.events_count,
-            dtype=np.float32
+        await task.run(
+            function_name=ELLIPSOIDS_FUNCTION_NAME,
+            args=[
+                gpu_values,
+                gpu_search_origins,
+                dx,
+                dy,
+                dz,
+                nx,
+                ny,
+                nz,
+                float(input_args.misfit_threshold),
+                cl.LocalMemory(group_size * np.dtype(np.float32).itemsize),
+                cl.LocalMemory(group_size * np.dtype(np.int32).itemsize),
+                cl.LocalMemory(
+                    ELLIPSOID_COLUMNS_COUNT * group_size * np.dtype(
+                        np.float32
+                    ).itemsize
+                ),
+                gpu_ellipsoids
+            ],
+            global_size=(group_size, events_count),
+            local_size=(group_size, 1)
+        )
+        self.__misfit_ellipsoids = await gpu_ellipsoids.get_from_gpu(
+            cl_queue=task.gpu_card.cl_queue
+        )
+        gpu_ellipsoids.release()
+        await self.add_log_message(text='Misfit ellipsoids were calculated')
+
+    async def __find_minimal_nodes(
+            self,
+            function_name: str,
+            args: List[Union[int, float, GPUArray]]
+    ):
+        # first stage kernel gets node values from the given args, then
+        # keeps minimum of work-group per event
+        input_args: DiffFunctionParameters = await self._args
+        events_count = input_args.events_count
+        nodes_count = input_args.spacing.nodes_count
+        task = await self._task
+
+        group_size = self.__get_reduction_group_size(task=task)
+        groups_count = self.__get_reduction_groups_count(
+            task=task,
+            nodes_count=nodes_count,
+            group_size=group_size
         )
+        local_args = [
+            cl.LocalMemory(group_size * np.dtype(np.float32).itemsize),
+            cl.LocalMemory(group_size * np.dtype(np.int32).itemsize)
+        ]
 
-        cube_size = input_args.spacing.nodes_count
-        for i in range(input_args.events_count):
-            start_index = i * cube_size
-            best_node_id, best_diff_function = EMPTY_ID, INF
-            for j in range(input_args.spacing.nodes_count):
-                diff_function_value = self._solution[j + start_index]
-                if diff_function_value == NULL_VALUE:
-                    continue
+        gpu_partial_values = GPUArray(
+            src=np.zeros(shape=(events_count, groups_count), dtype=np.float32),
+            is_read_write=True
+        )
+        gpu_partial_nodes = GPUArray(
+            src=np.zeros(shape=(events_count, groups_count), dtype=np.int32),
+            is_read_write=True
+        )
+        await task.run(
+            function_name=function_name,
+            args=[
+                *args,
+                *local_args,
+                gpu_partial_values,
+                gpu_partial_nodes
+            ],
+            global_size=(groups_count * group_size, events_count),
+            local_size=(group_size, 1)
+        )
 
-                if diff_function_value < best_diff_function:
-                    best_node_id = j
-                    best_diff_function = diff_function_value
+        gpu_minimal_nodes = GPUArray(
+            src=np.zeros(shape=events_count, dtype=np.int32)
+        )
+        gpu_errors = GPUArray(
+            src=np.zeros(shape=events_count, dtype=np.float32)
+        )
+        await task.run(
+            function_name=MERGE_MINIMAL_NODES_FUNCTION_NAME,
+            args=[
+                gpu_partial_values,
+                gpu_partial_nodes,
+                groups_count,
+                events_count,
+                *local_args,
+                gpu_minimal_nodes,
+                gpu_errors
+            ],
+            global_size=(group_size, events_count),
+            local_size=(group_size, 1)
+        )
 
-            if best_node_id == EMPTY_ID:
-                best_diff_function = NULL_VALUE
+        minimal_nodes = await gpu_minimal_nodes.get_from_gpu(
+            cl_queue=task.gpu_card.cl_queue
+        )
+        errors = await gpu_errors.get_from_gpu(
+            cl_queue=task.gpu_card.cl_queue
+        )
+        for gpu_array in (
+                gpu_partial_values, gpu_partial_nodes,
+                gpu_minimal_nodes, gpu_errors
+        ):
+            gpu_array.release()
 
-            node_ids[i] = best_node_id
-            diff_function_values[i] = best_diff_function
-        return node_ids, diff_function_values
+        self.__minimal_nodes = (minimal_nodes, errors)
+        await self.add_log_message(
+            text='Minimal nodes of diff function cubes were found'
+        )
+
+    async def __preprocess_solution(self) -> Tuple[np.ndarray, np.ndarray]:
+        minimal_nodes, errors = self.__minimal_nodes
+
+        is_empty = minimal_nodes == NULL_VALUE
+        node_ids = np.where(is_empty, EMPTY_ID, minimal_nodes)
+        diff_function_values = np.where(is_empty, NULL_VALUE, errors)
+        return (
+            node_ids.astype(np.int32),
+            diff_function_values.astype(np.float32)
+        )
+
+    @property
+    def best_nodes(self) -> Optional[np.ndarray]:
+        """Return the lowest misfit nodes of events.
+
+        Returns: array (events x best nodes count x 4) of (x, y, altitude,
+            diff function value) sorted by value, missing nodes have NaN
+            coordinates, None if best nodes were not requested
+
+        """
+        return self.__best_nodes
+
+    @property
+    def misfit_ellipsoids(self) -> Optional[np.ndarray]:
+        """Return mean and covariance of nodes under misfit threshold.
+
+        Returns: array (events x 10) of (nodes count, mean x, y, altitude,
+            covariance xx, xy, x-altitude, yy, y-altitude,
+            altitude-altitude), None if threshold was not given
+
+        """
+        return self.__misfit_ellipsoids
 
     @property
     async def solution(self) -> np.ndarray:
@@ -190,6 +1354,9 @@ class DiffFunction(GPUProcess):
         Returns: np.ndarray
 
         """
+        if self.__refined_solution is not None:
+            return self.__refined_solution
+
         node_ids, diff_function_values = await self.__preprocess_solution()
         minimization_data = np.zeros(
             shape=(0, 4),
@@ -202,18 +1369,13 @@ class DiffFunction(GPUProcess):
             if node_id == EMPTY_ID:
                 continue
 
-            spacing = input_args.spacing
-            ix, iy, iz = spacing.get_node_id(node_id=node_id)
+            ix, iy, iz = input_args.spacing.get_node_id(node_id=node_id)
             stepping = input_args.search_space.get_stepping(
                 spacing=input_args.spacing
             )
-            dx = stepping.dx * (ix - spacing.nx / 2)
-            dy = stepping.dy * (iy - spacing.ny / 2)
-            dz = stepping.dz * (iz - spacing.nz / 2)
-
-            x = input_args.search_space_centers[event_id, 0] + dx
-            y = input_args.search_space_centers[event_id, 1] + dy
-            z = input_args.search_space_centers[event_id, 2] + dz
+            x = self.__search_origins[event_id, 0] + stepping.dx * ix
+            y = self.__search_origins[event_id, 1] + stepping.dy * iy
+            z = self.__search_origins[event_id, 2] + stepping.dz * iz
 
             minimization_data = np.vstack(
                 (
@@ -5,8 +5,10 @@ from hamcrest import assert_that, equal_to
 
 from gstream.files.scripts import (
     DELAYS_SCRIPT_BODY,
+    DELAYS_STREAM_SCRIPT_BODY,
     BaseRunnerScriptFile,
-    DelaysRunnerScriptFile
+    DelaysRunnerScriptFile,
+    DelaysStreamRunnerScriptFile
 )
 
 
@@ -50,3 +52,25 @@ class TestDelaysRunnerScriptFile:
             actual_or_assertion=obj._BaseTxtFileWriter__body,
             matcher=equal_to(DELAYS_SCRIPT_BODY.replace('[task-id]', task_id))
         )
+
+
+class TestDelaysStreamRunnerScriptFile:
+
+    @pytest.mark.positive
+    def test_correct_attributes_positive(self):
+        path = Mock()
+        task_id = 'test-id'
+        obj = DelaysStreamRunnerScriptFile(
+            path=path,
+            task_id=task_id
+        )
+        assert_that(
+            actual_or_assertion=obj._BaseTxtFileWriter__path,
+            matcher=equal_to(path)
+        )
+        assert_that(
+            actual_or_assertion=obj._BaseTxtFileWriter__body,
+            matcher=equal_to(
+                DELAYS_STREAM_SCRIPT_BODY.replace('[task-id]', task_id)
+            )
+        )
@@ -1,5 +1,5 @@
 import pathlib
-from typing import List, Union
+from typing import List, Optional, Union
 from unittest.mock import MagicMock, Mock, PropertyMock, patch
 
 import pyopencl
@@ -9,6 +9,7 @@ from hamcrest import assert_that, equal_to, is_
 from gstream.node.common import MemoryInfo, convert_megabytes_to_bytes
 from gstream.node.gpu_rig import (
     FREE_MEMORY_SIZE_KEY,
+    MAX_CACHED_PROGRAMS_COUNT,
     MEMORY_SIZE_UNIT_IN_BYTES,
     TOTAL_MEMORY_SIZE_KEY,
     BusIdNotFound,
@@ -18,6 +19,7 @@ from gstream.node.gpu_rig import (
     GPURigInfo,
     NoFreeGPUCardException
 )
+from gstream.node.program_cache import ProgramCache
 
 
 class TestGPUCardInfo:
@@ -518,6 +520,134 @@ class TestGPUCard:
             matcher=equal_to(expected_value)
         )
 
+    @pytest.mark.positive
+    @patch.object(pyopencl.Program, 'build')
+    @patch('pyopencl.CommandQueue')
+    @patch('pyopencl.Context')
+    @patch.object(GPUCard, '_GPUCard__get_bus_id_and_uuid')
+    def test_compile_cl_core_cache_positive(
+            self,
+            mock_get_bus_id_and_uuid: Mock,
+            mock_context: Mock,
+            mock_queue: Mock,
+            mock_build: Mock
+    ):
+        mock_get_bus_id_and_uuid.return_value = ('test-bus-id', 'test-uuid')
+        mock_context.return_value = Mock()
+        mock_queue.return_value = Mock()
+        mock_build.side_effect = lambda options: Mock()
+
+        gpu_card = GPUCard(cl_gpu_device=Mock())
+        module = gpu_card.compile_cl_core(core='test-core', options=['-DA=1'])
+
+        assert_that(
+            actual_or_assertion=gpu_card.compile_cl_core(
+                core='test-core',
+                options=['-DA=1']
+            ),
+            matcher=is_(module)
+        )
+        assert_that(
+            actual_or_assertion=gpu_card.compile_cl_core(
+                core='test-core',
+                options=['-DA=2']
+            ) is module,
+            matcher=is_(False)
+        )
+        assert_that(
+            actual_or_assertion=mock_build.call_count,
+            matcher=equal_to(2)
+        )
+        mock_build.assert_called_with(options=['-DA=2'])
+
+    @pytest.mark.positive
+    @patch.object(pyopencl.Program, 'build')
+    @patch('pyopencl.CommandQueue')
+    @patch('pyopencl.Context')
+    @patch.object(GPUCard, '_GPUCard__get_bus_id_and_uuid')
+    def test_compile_cl_core_cache_size_positive(
+            self,
+            mock_get_bus_id_and_uuid: Mock,
+            mock_context: Mock,
+            mock_queue: Mock,
+            mock_build: Mock
+    ):
+        mock_get_bus_id_and_uuid.return_value = ('test-bus-id', 'test-uuid')
+        mock_context.return_value = Mock()
+        mock_queue.return_value = Mock()
+        mock_build.side_effect = lambda options: Mock()
+
+        gpu_card = GPUCard(cl_gpu_device=Mock())
+        for i in range(MAX_CACHED_PROGRAMS_COUNT + 1):
+            gpu_card.compile_cl_core(core='test-core', options=[f'-DA={i}'])
+        gpu_card.compile_cl_core(core='test-core', options=['-DA=1'])
+        gpu_card.compile_cl_core(core='test-core', options=['-DA=0'])
+
+        assert_that(
+            actual_or_assertion=mock_build.call_count,
+            matcher=equal_to(MAX_CACHED_PROGRAMS_COUNT + 2)
+        )
+
+    @pytest.mark.positive
+    @pytest.mark.parametrize(
+        'binary', [None, b'test-binary']
+    )
+    @patch.object(ProgramCache, 'get_key')
+    @patch('pyopencl.Program')
+    @patch('pyopencl.CommandQueue')
+    @patch('pyopencl.Context')
+    @patch.object(GPUCard, '_GPUCard__get_bus_id_and_uuid')
+    def test_compile_cl_core_program_cache_positive(
+            self,
+            mock_get_bus_id_and_uuid: Mock,
+            mock_context: Mock,
+            mock_queue: Mock,
+            mock_program: Mock,
+            mock_get_key: Mock,
+            binary: Optional[bytes]
+    ):
+        mock_get_key.return_value = 'test-key'
+        mock_get_bus_id_and_uuid.return_value = ('test-bus-id', 'test-uuid')
+        mock_context.return_value = Mock()
+        mock_queue.return_value = Mock()
+        module = mock_program.return_value.build.return_value
+        module.get_info.return_value = [b'built-binary']
+        program_cache = Mock()
+        program_cache.load.return_value = binary
+
+        cl_gpu_device = Mock()
+        gpu_card = GPUCard(cl_gpu_device=cl_gpu_device)
+        assert_that(
+            actual_or_assertion=gpu_card.compile_cl_core(
+                core='test-core',
+                options=['-DA=1'],
+                program_cache=program_cache
+            ),
+            matcher=equal_to(module)
+        )
+
+        if binary is None:
+            mock_program.assert_called_once_with(
+                gpu_card.cl_context, 'test-core'
+            )
+            program_cache.save.assert_called_once_with(
+                key='test-key',
+                binary=b'built-binary'
+            )
+        else:
+            mock_program.assert_called_once_with(
+                gpu_card.cl_context, [cl_gpu_device], [binary]
+            )
+            program_cache.save.assert_not_called()
+        mock_get_key.assert_called_once_with(
+            cl_gpu_device=cl_gpu_device,
+            core='test-core',
+            options=['-DA=1']
+        )
+        mock_program.return_value.build.assert_called_once_with(
+            options=['-DA=1']
+        )
+
     @pytest.mark.negative
     @patch.object(pyopencl.Program, 'build')
     @patch('pyopencl.CommandQueue')
@@ -661,6 +791,50 @@ class TestGPUCard:
             matcher=equal_to(expected_value)
         )
 
+    @pytest.mark.positive
+    @patch('pyopencl.CommandQueue')
+    @patch('pyopencl.Context')
+    @patch.object(GPUCard, '_GPUCard__get_bus_id_and_uuid')
+    def test_local_memory_size_positive(
+            self,
+            mock_get_bus_id_and_uuid: Mock,
+            mock_context: Mock,
+            mock_queue: Mock
+    ):
+        mock_get_bus_id_and_uuid.return_value = ('test-bus', 'test-uuid')
+        mock_context.return_value = None
+        mock_queue.return_value = None
+        expected_value = 'test'
+
+        assert_that(
+            actual_or_assertion=GPUCard(
+                cl_gpu_device=Mock(local_mem_size=expected_value)
+            ).local_memory_size,
+            matcher=equal_to(expected_value)
+        )
+
+    @pytest.mark.positive
+    @patch('pyopencl.CommandQueue')
+    @patch('pyopencl.Context')
+    @patch.object(GPUCard, '_GPUCard__get_bus_id_and_uuid')
+    def test_compute_units_count_positive(
+            self,
+            mock_get_bus_id_and_uuid: Mock,
+            mock_context: Mock,
+            mock_queue: Mock
+    ):
+        mock_get_bus_id_and_uuid.return_value = ('test-bus', 'test-uuid')
+        mock_context.return_value = None
+        mock_queue.return_value = None
+        expected_value = 'test'
+
+        assert_that(
+            actual_or_assertion=GPUCard(
+                cl_gpu_device=Mock(max_compute_units=expected_value)
+            ).compute_units_count,
+            matcher=equal_to(expected_value)
+        )
+
     @pytest.mark.positive
     @patch('pyopencl.CommandQueue')
     @patch('pyopencl.Context')
@@ -934,3 +1108,57 @@ class TestGPURig:
                 actual_or_assertion=error.value,
                 matcher=equal_to('All GPU card are busy now')
             )
+
+    @pytest.mark.positive
+    @pytest.mark.parametrize(
+        'max_cards_count, expected_count', [(None, 2), (1, 1)]
+    )
+    @patch.object(GPUCard, '__init__')
+    @patch.object(GPURig, 'gpu_cards', new_callable=PropertyMock)
+    @patch.object(GPURig, '_GPURig__get_cl_gpu_devices')
+    def test_get_free_gpu_cards_positive(
+            self,
+            mock_gpu_devices: Mock,
+            mock_gpu_cards: Mock,
+            mock_init: Mock,
+            max_cards_count: Optional[int],
+            expected_count: int
+    ):
+        free_volume = MagicMock(free_volume=1)
+        free_cards = [
+            MagicMock(is_free=True, memory_info=free_volume) for _ in range(2)
+        ]
+        busy_card = MagicMock(is_free=False, memory_info=free_volume)
+        mock_gpu_devices.return_value = [MagicMock()]
+        mock_gpu_cards.return_value = [free_cards[0], busy_card, free_cards[1]]
+        mock_init.return_value = None
+
+        assert_that(
+            actual_or_assertion=GPURig().get_free_gpu_cards(
+                required_memory_size=free_volume.free_volume - 1,
+                max_cards_count=max_cards_count
+            ),
+            matcher=equal_to(free_cards[:expected_count])
+        )
+
+    @pytest.mark.negative
+    @patch.object(GPUCard, '__init__')
+    @patch.object(GPURig, 'gpu_cards', new_callable=PropertyMock)
+    @patch.object(GPURig, '_GPURig__get_cl_gpu_devices')
+    def test_get_free_gpu_cards_negative(
+            self,
+            mock_gpu_devices: Mock,
+            mock_gpu_cards: Mock,
+            mock_init: Mock
+    ):
+        free_volume = MagicMock(free_volume=1)
+        mock_gpu_devices.return_value = [MagicMock()]
+        mock_gpu_cards.return_value = [
+            MagicMock(is_free=True, memory_info=free_volume)
+        ]
+        mock_init.return_value = None
+
+        with pytest.raises(NoFreeGPUCardException):
+            GPURig().get_free_gpu_cards(
+                required_memory_size=free_volume.free_volume
+            )
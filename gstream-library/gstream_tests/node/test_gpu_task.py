@@ -87,6 +87,26 @@ class TestGPUArray:
             matcher=equal_to(expected_value)
         )
 
+    @pytest.mark.positive
+    @pytest.mark.parametrize(
+        ['is_copy', 'expected_value'],
+        [
+            (True, cl.mem_flags.READ_WRITE | cl.mem_flags.COPY_HOST_PTR),
+            (False, cl.mem_flags.READ_WRITE)
+        ]
+    )
+    def test_flags_read_write_positive(
+            self,
+            is_copy: bool,
+            expected_value: int
+    ):
+        obj = GPUArray(src=np.arange(9), is_copy=is_copy, is_read_write=True)
+
+        assert_that(
+            actual_or_assertion=obj._GPUArray__flags,
+            matcher=equal_to(expected_value)
+        )
+
     @pytest.mark.positive
     def test_bytes_size_positive(self):
         src = np.arange(9)
@@ -176,6 +196,115 @@ class TestGPUArray:
             matcher=equal_to(True)
         )
 
+    @pytest.mark.positive
+    @pytest.mark.parametrize(
+        'is_buffer_none', [True, False]
+    )
+    @patch.object(cl, 'enqueue_copy')
+    @pytest.mark.asyncio
+    async def test_set_to_gpu_positive(
+            self,
+            mock_enqueue_copy: Mock,
+            is_buffer_none: bool
+    ):
+        obj = GPUArray(src=np.zeros(9), is_copy=True)
+        if not is_buffer_none:
+            obj._GPUArray__cl_buffer = 'test'
+
+        src = np.arange(9, dtype=np.float64)
+        await obj.set_to_gpu(cl_queue=Mock(), src=src)
+
+        assert_that(
+            actual_or_assertion=obj == GPUArray(src=src),
+            matcher=equal_to(True)
+        )
+        assert_that(
+            actual_or_assertion=mock_enqueue_copy.call_count,
+            matcher=equal_to(0 if is_buffer_none else 1)
+        )
+
+    @pytest.mark.negative
+    @pytest.mark.asyncio
+    async def test_set_to_gpu_negative(self):
+        obj = GPUArray(src=np.zeros(9))
+        with pytest.raises(ValueError):
+            await obj.set_to_gpu(cl_queue=Mock(), src=np.zeros(8))
+
+    @pytest.mark.positive
+    @patch.object(cl, 'enqueue_copy')
+    @pytest.mark.asyncio
+    async def test_set_to_gpu_rows_count_positive(
+            self,
+            mock_enqueue_copy: Mock
+    ):
+        obj = GPUArray(src=np.zeros(shape=(4, 3)), is_copy=True)
+        obj._GPUArray__cl_buffer = 'test'
+
+        src = np.arange(6, dtype=np.float64).reshape((2, 3))
+        await obj.set_to_gpu(cl_queue=Mock(), src=src, rows_count=2)
+
+        assert_that(
+            actual_or_assertion=obj == GPUArray(
+                src=np.concatenate((src, np.zeros(shape=(2, 3))))
+            ),
+            matcher=equal_to(True)
+        )
+        assert_that(
+            actual_or_assertion=mock_enqueue_copy.call_args[0][2].shape,
+            matcher=equal_to((2, 3))
+        )
+
+    @pytest.mark.negative
+    @pytest.mark.asyncio
+    async def test_set_to_gpu_rows_count_negative(self):
+        obj = GPUArray(src=np.zeros(shape=(4, 3)))
+        with pytest.raises(ValueError):
+            await obj.set_to_gpu(
+                cl_queue=Mock(), src=np.zeros(shape=(3, 3)), rows_count=2
+            )
+
+    @pytest.mark.positive
+    @patch.object(cl, 'enqueue_copy')
+    @pytest.mark.asyncio
+    async def test_get_from_gpu_rows_count_positive(
+            self,
+            mock_enqueue_copy: Mock
+    ):
+        src = np.arange(12).reshape((4, 3))
+        obj = GPUArray(src=src)
+        obj._GPUArray__cl_buffer = 'test'
+        mock_enqueue_copy.return_value = None
+
+        assert_that(
+            actual_or_assertion=np.array_equal(
+                await obj.get_from_gpu(cl_queue=Mock(), rows_count=2),
+                src[:2]
+            ),
+            matcher=equal_to(True)
+        )
+        assert_that(
+            actual_or_assertion=mock_enqueue_copy.call_args[0][1].shape,
+            matcher=equal_to((2, 3))
+        )
+
+    @pytest.mark.positive
+    @patch.object(cl, 'enqueue_copy')
+    @pytest.mark.asyncio
+    async def test_get_from_gpu_zero_rows_count_positive(
+            self,
+            mock_enqueue_copy: Mock
+    ):
+        obj = GPUArray(src=np.arange(12).reshape((4, 3)))
+        obj._GPUArray__cl_buffer = 'test'
+
+        assert_that(
+            actual_or_assertion=(
+                await obj.get_from_gpu(cl_queue=Mock(), rows_count=0)
+            ).shape,
+            matcher=equal_to((0, 3))
+        )
+        mock_enqueue_copy.assert_not_called()
+
     @pytest.mark.positive
     @pytest.mark.parametrize(
         'is_logic_error', [True, False]
@@ -221,6 +350,26 @@ class TestGPUTask:
             matcher=equal_to([])
         )
 
+    @pytest.mark.positive
+    def test_build_options_positive(self):
+        gpu_card = Mock()
+        obj = GPUTask(
+            gpu_card=gpu_card,
+            core='test-core',
+            definitions={'WINDOW_SIZE': 30, 'FLAG': None, 'LAYERS_COUNT': 4}
+        )
+        expected_value = ['-DFLAG', '-DLAYERS_COUNT=4', '-DWINDOW_SIZE=30']
+
+        assert_that(
+            actual_or_assertion=obj.build_options,
+            matcher=equal_to(expected_value)
+        )
+        gpu_card.compile_cl_core.assert_called_once_with(
+            core='test-core',
+            options=expected_value,
+            program_cache=None
+        )
+
     @pytest.mark.positive
     @patch.object(GPUCard, 'compile_cl_core')
     def test_gpu_card_positive(self, mock_compile_cl_core: Mock):
@@ -282,6 +431,43 @@ class TestGPUTask:
         )
         mock_load_args.assert_called_once_with(args=args)
 
+    @pytest.mark.positive
+    @pytest.mark.parametrize(
+        ['global_size', 'local_size'],
+        [
+            (None, None),
+            ((1024,), None),
+            ((64, 8), (16, 8))
+        ]
+    )
+    @patch.object(GPUTask, '_GPUTask__load_args')
+    @patch.object(GPUCard, 'compile_cl_core')
+    @pytest.mark.asyncio
+    async def test_run_sizes_positive(
+            self,
+            mock_compile_cl_core: Mock,
+            mock_load_args: Mock,
+            global_size: tuple,
+            local_size: tuple
+    ):
+        cl_module = Mock()
+        mock_compile_cl_core.return_value = cl_module
+        gpu_card = Mock()
+        gpu_card.compile_cl_core = mock_compile_cl_core
+
+        await GPUTask(gpu_card=gpu_card, core='core').run(
+            function_name='q',
+            args=[],
+            global_size=global_size,
+            local_size=local_size
+        )
+
+        if global_size is None:
+            global_size = gpu_card.max_grid_size
+        cl_module.q.assert_called_once_with(
+            gpu_card.cl_queue, global_size, local_size
+        )
+
     @pytest.mark.negative
     @patch.object(GPUTask, '_GPUTask__load_args')
     @patch.object(GPUCard, 'compile_cl_core')
@@ -380,6 +566,18 @@ class TestGPUTask:
             matcher=is_(None)
         )
 
+    @pytest.mark.positive
+    @pytest.mark.asyncio
+    async def test_convert_to_gpu_type_local_memory_positive(self):
+        arg = cl.LocalMemory(1024)
+        assert_that(
+            actual_or_assertion=await GPUTask(
+                gpu_card=Mock(),
+                core='core'
+            )._GPUTask__convert_to_gpu_type(arg),
+            matcher=is_(arg)
+        )
+
     # TODO: add test for __convert_to_gpu_type
     # TODO: add test for __convert_from int
     # TODO: add test for __convert_from float
@@ -0,0 +1,119 @@
+import pathlib
+from unittest.mock import MagicMock, Mock, patch
+
+import pytest
+from hamcrest import assert_that, equal_to, is_
+
+from gstream.node.program_cache import (
+    PROGRAM_FILE_EXTENSION,
+    PROGRAMS_FOLDER_SUFFIX,
+    ProgramCache
+)
+
+
+def get_cl_gpu_device(driver_version: str = '1.0') -> MagicMock:
+    cl_gpu_device = MagicMock()
+    cl_gpu_device.vendor = 'test-vendor'
+    cl_gpu_device.name = 'test-name'
+    cl_gpu_device.driver_version = driver_version
+    cl_gpu_device.version = 'OpenCL 3.0'
+    return cl_gpu_device
+
+
+class TestProgramCache:
+
+    @pytest.mark.positive
+    def test_create_next_to_positive(self, tmp_path: pathlib.Path):
+        storage_root = pathlib.Path(tmp_path, 'storage')
+
+        assert_that(
+            actual_or_assertion=ProgramCache.create_next_to(
+                storage_root=storage_root
+            ).root,
+            matcher=equal_to(
+                pathlib.Path(tmp_path, f'storage{PROGRAMS_FOLDER_SUFFIX}')
+            )
+        )
+
+    @pytest.mark.positive
+    @pytest.mark.parametrize(
+        'driver_version, core, options, is_equal', [
+            ('1.0', 'test-core', ['-DA=1'], True),
+            ('2.0', 'test-core', ['-DA=1'], False),
+            ('1.0', 'other-core', ['-DA=1'], False),
+            ('1.0', 'test-core', ['-DA=2'], False),
+            ('1.0', 'test-core', [], False)
+        ]
+    )
+    def test_get_key_positive(
+            self,
+            driver_version: str,
+            core: str,
+            options: list,
+            is_equal: bool
+    ):
+        key = ProgramCache.get_key(
+            cl_gpu_device=get_cl_gpu_device(),
+            core='test-core',
+            options=['-DA=1']
+        )
+        other_key = ProgramCache.get_key(
+            cl_gpu_device=get_cl_gpu_device(driver_version=driver_version),
+            core=core,
+            options=options
+        )
+
+        assert_that(
+            actual_or_assertion=key == other_key,
+            matcher=is_(is_equal)
+        )
+
+    @pytest.mark.positive
+    def test_save_load_positive(self, tmp_path: pathlib.Path):
+        root = pathlib.Path(tmp_path, 'programs')
+        program_cache = ProgramCache(root=root)
+        binary = b'test-binary'
+
+        assert_that(
+            actual_or_assertion=program_cache.load(key='test-key'),
+            matcher=is_(None)
+        )
+
+        program_cache.save(key='test-key', binary=binary)
+        assert_that(
+            actual_or_assertion=program_cache.load(key='test-key'),
+            matcher=equal_to(binary)
+        )
+        assert_that(
+            actual_or_assertion=sorted(item.name for item in root.iterdir()),
+            matcher=equal_to([f'test-key{PROGRAM_FILE_EXTENSION}'])
+        )
+
+    @pytest.mark.negative
+    def test_save_negative(self, tmp_path: pathlib.Path):
+        root = pathlib.Path(tmp_path, 'programs')
+        root.write_bytes(b'')
+        program_cache = ProgramCache(root=root)
+
+        program_cache.save(key='test-key', binary=b'test-binary')
+        assert_that(
+            actual_or_assertion=program_cache.load(key='test-key'),
+            matcher=is_(None)
+        )
+
+    @pytest.mark.negative
+    @patch('os.replace')
+    def test_save_replace_negative(
+            self,
+            mock_replace: Mock,
+            tmp_path: pathlib.Path
+    ):
+        mock_replace.side_effect = OSError
+        root = pathlib.Path(tmp_path, 'programs')
+        program_cache = ProgramCache(root=root)
+
+        program_cache.save(key='test-key', binary=b'test-binary')
+        assert_that(
+            actual_or_assertion=list(root.iterdir()),
+            matcher=equal_to([])
+        )
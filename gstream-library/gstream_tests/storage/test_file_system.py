@@ -150,6 +150,53 @@ class TestStorage:
             matcher=equal_to(expected_value)
         )
 
+    @pytest.mark.positive
+    @pytest.mark.asyncio
+    @patch('aiofiles.open')
+    @patch.object(pathlib.PurePath, '_from_parts')
+    async def test_append_binary_data_positive(
+            self,
+            mock_from_parts: Mock,
+            mock_open: AsyncMock
+    ):
+        mock_from_parts._flavour.is_supported = True
+
+        mock_file = AsyncMock()
+        mock_file.write.return_value = None
+
+        mock_open.return_value.__aenter__.return_value = mock_file
+        data = b'data'
+
+        await Storage(root=Mock()).append_binary_data(data=data, filename='')
+        mock_file.write.assert_called_once_with(data)
+        assert_that(
+            actual_or_assertion=mock_open.call_args[0][1],
+            matcher=equal_to('ab')
+        )
+
+    @pytest.mark.positive
+    @pytest.mark.asyncio
+    @patch('aiofiles.open')
+    @patch.object(pathlib.PurePath, '_from_parts')
+    async def test_get_binary_data_from_file_offset_positive(
+            self,
+            mock_from_parts: Mock,
+            mock_open: AsyncMock
+    ):
+        mock_from_parts.return_value.exists.return_value = True
+        mock_from_parts._flavour.is_supported = True
+
+        mock_file = AsyncMock()
+        mock_file.read.return_value = b'test'
+
+        mock_open.return_value.__aenter__.return_value = mock_file
+
+        await Storage(root=Mock()).get_binary_data_from_file(
+            filename='',
+            offset=2
+        )
+        mock_file.seek.assert_called_once_with(2)
+
     @pytest.mark.negative
     @pytest.mark.asyncio
     @patch.object(pathlib.PurePath, '_from_parts')
@@ -0,0 +1,125 @@
+"""Print accuracy envelope of single precision rays (see README).
+
+Travel times of the rays grid are calculated by the diff function kernel
+on the first GPU card of the node with both ray solvers, in double and in
+single precision, and compared in samples.
+"""
+
+import asyncio
+from pathlib import Path
+
+import numpy as np
+
+import gstream
+from gstream.core_models import Layer, Range, SeismicModel
+from gstream.models import RaySolver
+from gstream.node.gpu_rig import GPUCard, GPURig
+from gstream.node.gpu_task import GPUArray, GPUTask
+from gstream.worker.diff_function import (
+    KERNEL_FILENAME,
+    NULL_VALUE,
+    get_kernel_model
+)
+
+FUNCTION_NAME = 'test_get_ray_times'
+RECEIVER_ALTITUDE = -50.
+ACCURACY = 1.
+FREQUENCY = 500
+
+
+def get_seismic_model() -> SeismicModel:
+    return SeismicModel(
+        layers=[
+            Layer(altitude_range=Range(min_=-200, max_=0), vp=2000),
+            Layer(altitude_range=Range(min_=-1000, max_=-200), vp=3500),
+            Layer(altitude_range=Range(min_=-3000, max_=-1000), vp=5000)
+        ]
+    )
+
+
+def get_rays_grid() -> np.ndarray:
+    # rows of (source altitude, offset)
+    source_altitudes = np.arange(-2950, -60, 23.7, dtype=np.float32)
+    offsets = np.arange(0, 5000, 37.3, dtype=np.float32)
+    return np.stack(
+        np.meshgrid(source_altitudes, offsets, indexing='ij'), axis=-1
+    ).reshape(-1, 2)
+
+
+async def get_ray_times(
+        gpu_card: GPUCard,
+        ray_solver: RaySolver,
+        is_single_precision: bool
+) -> np.ndarray:
+    definitions = {'RAY_SOLVER': ray_solver.value}
+    if is_single_precision:
+        definitions['SINGLE_PRECISION_RAYS'] = None
+    core_path = Path(Path(gstream.__file__).parent, 'kernels', KERNEL_FILENAME)
+    task = GPUTask(
+        gpu_card=gpu_card,
+        core=core_path.read_text(),
+        definitions=definitions
+    )
+
+    seismic_model = get_seismic_model()
+    rays_grid = get_rays_grid()
+    gpu_times = GPUArray(
+        src=np.zeros(shape=rays_grid.shape[0], dtype=np.float32)
+    )
+    await task.run(
+        function_name=FUNCTION_NAME,
+        args=[
+            GPUArray(
+                src=get_kernel_model(seismic_model=seismic_model),
+                is_copy=True
+            ),
+            seismic_model.layers_count,
+            GPUArray(src=np.ascontiguousarray(rays_grid[:, 0]), is_copy=True),
+            GPUArray(src=np.ascontiguousarray(rays_grid[:, 1]), is_copy=True),
+            rays_grid.shape[0],
+            RECEIVER_ALTITUDE,
+            ACCURACY,
+            FREQUENCY,
+            gpu_times
+        ],
+        global_size=(rays_grid.shape[0],)
+    )
+    return await gpu_times.get_from_gpu(cl_queue=gpu_card.cl_queue)
+
+
+async def main():
+    gpu_card = GPURig().gpu_cards[0]
+    print(f'Device: {gpu_card.cl_gpu_device.name}, '
+          f'{get_rays_grid().shape[0]} rays')
+    print('| Ray solver | Mean, samples | 99%, samples | Max, samples '
+          '| Integer time changed | NULL changed |')
+    for ray_solver in RaySolver:
+        double_times, single_times = [
+            await get_ray_times(
+                gpu_card=gpu_card,
+                ray_solver=ray_solver,
+                is_single_precision=is_single_precision
+            ) for is_single_precision in (False, True)
+        ]
+        null_changed_count = np.count_nonzero(
+            (double_times == NULL_VALUE) != (single_times == NULL_VALUE)
+        )
+        is_valid = np.logical_and(
+            double_times != NULL_VALUE, single_times != NULL_VALUE
+        )
+        double_times = double_times[is_valid]
+        single_times = single_times[is_valid]
+        errors = np.abs(double_times - single_times)
+        changed_share = np.mean(
+            np.trunc(double_times) != np.trunc(single_times)
+        )
+        print(f'| {ray_solver.name.capitalize()} '
+              f'| {errors.mean():.3f} '
+              f'| {np.percentile(errors, 99):.3f} '
+              f'| {errors.max():.3f} '
+              f'| {changed_share:.2%} '
+              f'| {null_changed_count} rays |')
+
+
+if __name__ == '__main__':
+    asyncio.run(main())